@@ -1,70 +1,96 @@
 #include "BCH26.h"
 
-#define gx 0x05B9<<(26-11)
+/* ---------------------------------------------------------------------- */
 
-unsigned int CheckMatrix[26][2] = {
-        {119, 33554432},
-        {743, 16777216},
-        {943, 8388608},
-        {779, 4194304},
-        {857, 2097152},
-        {880, 1048576},
-        {440, 524288},
-        {220, 262144},
-        {110, 131072},
-        {55,  65536},
-        {711, 32768},
-        {959, 16384},
-        {771, 8192},
-        {861, 4096},
-        {882, 2048},
-        {441, 1024},
-        {512, 512},
-        {256, 256},
-        {128, 128},
-        {64,  64},
-        {32,  32},
-        {16,  16},
-        {8,   8},
-        {4,   4},
-        {2,   2},
-        {1,   1}
-};
+/*
+ * Table driven decoder for the BCH(26,16) units of CIR frames. It
+ * replaces a bit serial decoder that searched a check matrix, which is
+ * now in bchtest.c as the reference. The syndrome of a unit is its
+ * remainder modulo g(x), bit i being the coefficient of x^i, so the 16
+ * data bits go through two byte tables and the 10 parity bits are taken
+ * as they are. fix_tab holds the error pattern the old decoder would
+ * pick for every syndrome. g(x) leaves some double errors with the same
+ * syndrome as another error, there the first one in its search order
+ * wins, just as it does there.
+ */
 
-unsigned int decode_BCH_26_16(unsigned int code, unsigned int *value) {
-    // this code is adapted from: https://blog.csdn.net/u012750235/article/details/84622161
-    unsigned int decode = 0;
-    unsigned int res;
-    decode = code;
-    //2.1 calculate remainder
-    for (int i = 0; i < 16; i++) {
-        if ((code & 0x2000000) != 0) {
-            code ^= gx;
-        }
-        code = code << 1;
-    }
-    res = code >> (26 - 10);
-    if (res == 0) {
-        *value = decode;
-        return 0;
-    }
-    //2.2 correct one bit error
-    for (int i = 0; i < 26; i++) {
-        if (res == CheckMatrix[i][0]) {
-            decode = decode ^ CheckMatrix[i][1];
-            *value = decode;
-            return 1;
-        }
-    }
-    //2.3 correct two bit error
-    for (int i = 0; i < 26; i++) {
-        for (int j = i + 1; j < 26; j++) {
-            if (res == (CheckMatrix[i][0] ^ CheckMatrix[j][0])) {
-                decode = decode ^ CheckMatrix[i][1] ^ CheckMatrix[j][1];
-                *value = decode;
-                return 2;
-            }
-        }
+#define BCH26_POLY   0x5B9
+#define BCH26_PARITY 10
+#define BCH26_NOFIX  0xffffffffu
+
+static uint16_t rem_tab[2][256];        /* (byte << (10 + 8*k)) mod g */
+static uint32_t fix_tab[1 << BCH26_PARITY];
+static int initialized;
+
+static unsigned int poly_rem(uint32_t v) {
+    int i;
+
+    for (i = 25; i >= BCH26_PARITY; i--)
+        if (v & (1u << i))
+            v ^= (uint32_t) BCH26_POLY << (i - BCH26_PARITY);
+    return v;
+}
+
+static inline unsigned int syndrome(uint32_t unit) {
+    return (unit & ((1u << BCH26_PARITY) - 1)) ^ rem_tab[0][(unit >> 10) & 0xff] ^
+           rem_tab[1][(unit >> 18) & 0xff];
+}
+
+static inline unsigned int fix_weight(uint32_t fix) {
+    return fix ? (fix & (fix - 1) ? 2 : 1) : 0;
+}
+
+void bch26_init(void) {
+    unsigned int i, j, k;
+
+    if (initialized)
+        return;
+    for (k = 0; k < 2; k++)
+        for (i = 0; i < 256; i++)
+            rem_tab[k][i] = poly_rem((uint32_t) i << (BCH26_PARITY + 8 * k));
+
+    for (i = 0; i < (1u << BCH26_PARITY); i++)
+        fix_tab[i] = BCH26_NOFIX;
+    fix_tab[0] = 0;
+    /* in the search order of the old decoder, from the first bit received */
+    for (i = 26; i-- > 0; )
+        if (fix_tab[syndrome(1u << i)] == BCH26_NOFIX)
+            fix_tab[syndrome(1u << i)] = 1u << i;
+    for (i = 26; i-- > 0; )
+        for (j = i; j-- > 0; )
+            if (fix_tab[syndrome((1u << i) | (1u << j))] == BCH26_NOFIX)
+                fix_tab[syndrome((1u << i) | (1u << j))] = (1u << i) | (1u << j);
+    initialized = 1;
+}
+
+int bch26_correct(uint32_t *unit) {
+    uint32_t fix = fix_tab[syndrome(*unit)];
+
+    if (fix == BCH26_NOFIX)
+        return -1;
+    *unit = (*unit ^ fix) & 0x3ffffff;
+    return fix_weight(fix);
+}
+
+unsigned int bch26_decode_units(const unsigned char *bits, unsigned int nunits,
+                                unsigned char *data, unsigned int *corrected) {
+    unsigned int u, pos, fixed = 0;
+    uint32_t unit, fix;
+
+    for (u = 0, pos = 0; u < nunits; u++, pos += 26) {
+        /* units start on even bits, so each one lies within four bytes */
+        unit = ((uint32_t) bits[pos >> 3] << 24 | (uint32_t) bits[(pos >> 3) + 1] << 16 |
+                (uint32_t) bits[(pos >> 3) + 2] << 8 | bits[(pos >> 3) + 3]);
+        unit = (unit >> (6 - (pos & 7))) & 0x3ffffff;
+        fix = fix_tab[syndrome(unit)];
+        if (fix == BCH26_NOFIX)
+            break;
+        fixed += fix_weight(fix);
+        unit ^= fix;
+        *data++ = unit >> 18;
+        *data++ = unit >> 10;
     }
-    return 3;
+    if (corrected)
+        *corrected = fixed;
+    return u;
 }
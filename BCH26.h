@@ -1,5 +1,26 @@
 #ifndef MULTIMON_NG_BCH26_H
 #define MULTIMON_NG_BCH26_H
 
+#include <stdint.h>
+
+/* Builds the tables, must be called before the first bch26_correct() */
+void bch26_init(void);
+
+/*
+ * Corrects up to two bit errors in a 26 bit unit (16 data bits on top of
+ * 10 parity bits) in place. Returns the number of bits corrected or -1 if
+ * the unit is uncorrectable, in which case *unit is left alone.
+ */
+int bch26_correct(uint32_t *unit);
+
+/*
+ * Decodes nunits units packed MSB first one after the other in bits, as
+ * they were received, into two data bytes each. bits must be readable up
+ * to three bytes past the last unit. Stops at the first uncorrectable
+ * unit and returns the number of units decoded; the bits corrected in
+ * them go to *corrected if that is not NULL.
+ */
+unsigned int bch26_decode_units(const unsigned char *bits, unsigned int nunits,
+                                unsigned char *data, unsigned int *corrected);
+
 #endif //MULTIMON_NG_BCH26_H
-unsigned int decode_BCH_26_16(unsigned int code, unsigned int *value);
@@ -0,0 +1,91 @@
+/*
+ *      BCH3121.c -- table driven BCH(31,21) decoder for FLEX
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include "BCH3121.h"
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * FLEX sends the coefficient of x^30 first and shifts it down to bit 0, so
+ * bit j of a received word is the coefficient of x^(30-j) of the codeword.
+ * Read the other way round, with bit j as x^j, every word is a codeword of
+ * the code generated by the reciprocal polynomial, and the
+ * syndrome is the plain remainder of the word, no bit reversal needed.
+ *
+ * g(x)  = (x^5+x^2+1)(x^5+x^4+x^3+x^2+1) = x^10+x^9+x^8+x^6+x^5+x^3+1
+ * g*(x) = x^10 g(1/x)                    = x^10+x^7+x^5+x^4+x^2+x+1
+ */
+#define BCH_POLY    0x4b7
+#define BCH_PARITY  10
+#define NO_FIX      0xffffffffu
+
+static uint16_t rem_tab[3][256];        /* (byte << (10 + 8*k)) mod g */
+static uint32_t fix_tab[1 << BCH_PARITY];
+static int initialized;
+
+static unsigned int poly_rem(uint32_t v)
+{
+	int i;
+
+	for (i = 31; i >= BCH_PARITY; i--)
+		if (v & (1u << i))
+			v ^= (uint32_t)BCH_POLY << (i - BCH_PARITY);
+	return v;
+}
+
+static inline unsigned int syndrome(uint32_t w)
+{
+	uint32_t hi = (w & 0x7fffffff) >> BCH_PARITY;
+
+	return (w & ((1u << BCH_PARITY) - 1)) ^ rem_tab[0][hi & 0xff] ^
+		rem_tab[1][(hi >> 8) & 0xff] ^ rem_tab[2][hi >> 16];
+}
+
+void bch3121_init(void)
+{
+	unsigned int i, j, k;
+
+	if (initialized)
+		return;
+	for (k = 0; k < 3; k++)
+		for (i = 0; i < 256; i++)
+			rem_tab[k][i] = poly_rem((uint32_t)i << (BCH_PARITY + 8*k));
+
+	/* every single and double error has its own syndrome (d = 5) */
+	for (i = 0; i < (1u << BCH_PARITY); i++)
+		fix_tab[i] = NO_FIX;
+	fix_tab[0] = 0;
+	for (i = 0; i < 31; i++) {
+		fix_tab[syndrome(1u << i)] = 1u << i;
+		for (j = i + 1; j < 31; j++)
+			fix_tab[syndrome((1u << i) | (1u << j))] = (1u << i) | (1u << j);
+	}
+	initialized = 1;
+}
+
+int bch3121_correct(uint32_t *word)
+{
+	uint32_t fix = fix_tab[syndrome(*word)];
+
+	if (fix == NO_FIX)
+		return -1;
+	*word = (*word ^ fix) & 0x7fffffff;
+	return fix ? (fix & (fix - 1) ? 2 : 1) : 0;
+}
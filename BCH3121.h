@@ -0,0 +1,35 @@
+/*
+ *      BCH3121.h -- table driven BCH(31,21) decoder for FLEX
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _BCH3121_H
+#define _BCH3121_H
+
+#include <stdint.h>
+
+/* Builds the tables, must be called before the first bch3121_correct() */
+void bch3121_init(void);
+
+/*
+ * Corrects up to two bit errors in the 31 bit codeword in bits 0..30 of
+ * *word (bits 0..20 data, 21..30 parity, as FLEX receives it). Bit 31 is
+ * cleared. Returns the number of bits corrected or -1 if the word is
+ * uncorrectable, in which case *word is left alone.
+ */
+int bch3121_correct(uint32_t *word);
+
+#endif /* _BCH3121_H */
@@ -0,0 +1,341 @@
+/*
+ *      actindex.c -- build an activity index for a raw recording
+ *
+ *      Makes one pass over a long recording of raw 16 bit samples and
+ *      writes a small sidecar file (see actindex.h) with the level and the
+ *      tone/FSK bands of every 100 ms. multimon-ng --index then decodes
+ *      only the active parts of the recording.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include "actindex.h"
+#include "filter.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#ifdef _MSC_VER
+#include "win32_getopt.h"
+#else
+#include <unistd.h>
+#endif
+
+/* ---------------------------------------------------------------------- */
+
+#define BAND_LO      300.0    /* centre of the lowest band */
+#define BAND_HI      3600.0   /* centre of the highest band */
+#define BAND_SHARE   0.2f     /* share of the block energy that makes a band "present" */
+#define FLOOR_RISE   0.01f    /* dB per block the noise floor creeps up */
+#define SILENCE_DB   -90.0f   /* never active below this */
+#define FLOOR_PRIME  300      /* blocks looked at before the first verdict */
+
+/*
+ * The band analysis runs ACTINDEX_BANDS two pole resonators side by side,
+ * eight to a v8sf.
+ */
+#define NVEC         (ACTINDEX_BANDS / 8)
+#define BAND(v, b)   LANE((v)[(b) / 8], (b) % 8)
+
+struct bank {
+	v8sf a1[NVEC], a2[NVEC], g[NVEC];       /* coefficients */
+	v8sf y1[NVEC], y2[NVEC], pwr[NVEC];     /* state and energy of the current block */
+	float x1, x2;
+};
+
+static void bank_init(struct bank *bk, unsigned int sample_rate, uint16_t *band_hz)
+{
+	double ratio = pow(BAND_HI / BAND_LO, 1.0 / (ACTINDEX_BANDS - 1));
+	unsigned int b;
+
+	memset(bk, 0, sizeof(*bk));
+	for (b = 0; b < ACTINDEX_BANDS; b++) {
+		double f = BAND_LO * pow(ratio, b);
+		/* neighbouring bands meet at their -3 dB points */
+		double r = 1.0 - M_PI * f * (ratio - 1.0) / sample_rate;
+		if (f > 0.45 * sample_rate) {
+			band_hz[b] = 0;          /* above Nyquist, stays silent */
+			continue;
+		}
+		band_hz[b] = f + 0.5;
+		BAND(bk->a1, b) = 2.0 * r * cos(2.0 * M_PI * f / sample_rate);
+		BAND(bk->a2, b) = r * r;
+		BAND(bk->g, b) = (1.0 - r * r) / 2.0;
+	}
+}
+
+/* the eight bands of a vector are run over the whole block in turn */
+static inline void bank_run(struct bank *bk, const float *x, unsigned int n)
+{
+	unsigned int i, v;
+
+	for (v = 0; v < NVEC; v++) {
+		v8sf y1 = bk->y1[v], y2 = bk->y2[v], pwr = bk->pwr[v];
+		const v8sf a1 = bk->a1[v], a2 = bk->a2[v], g = bk->g[v];
+		float x2 = bk->x2, x1 = bk->x1;
+
+		for (i = 0; i < n; i++) {
+			v8sf y;
+#ifdef HAVE_VECTORS
+			y = g * SPLAT8(x[i] - x2) + a1 * y1 - a2 * y2;
+			pwr += y * y;
+#else
+			unsigned int l;
+			for (l = 0; l < 8; l++) {
+				LANE(y, l) = LANE(g, l) * (x[i] - x2) + LANE(a1, l) * LANE(y1, l) -
+					LANE(a2, l) * LANE(y2, l);
+				LANE(pwr, l) += LANE(y, l) * LANE(y, l);
+			}
+#endif
+			y2 = y1;
+			y1 = y;
+			x2 = x1;
+			x1 = x[i];
+		}
+		bk->y1[v] = y1;
+		bk->y2[v] = y2;
+		bk->pwr[v] = pwr;
+	}
+	if (n >= 2) {
+		bk->x1 = x[n - 1];
+		bk->x2 = x[n - 2];
+	} else if (n) {
+		bk->x2 = bk->x1;
+		bk->x1 = x[0];
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * The noise floor follows quiet blocks down immediately and creeps up
+ * slowly, so that long transmissions do not become the floor. It starts
+ * out at the quietest of the first FLOOR_PRIME blocks, otherwise a
+ * recording starting with a transmission would take that as its floor.
+ */
+static float threshold = 10.0f;
+static float floor_db;
+static float prime_db[FLOOR_PRIME];
+static struct actindex_block prime_rec[FLOOR_PRIME];
+static unsigned int nprime;
+static uint64_t nblk, nactive;
+
+static void judge(struct actindex_block *rec, float level_db, FILE *out)
+{
+	if (level_db < floor_db)
+		floor_db = level_db;
+	else
+		floor_db += FLOOR_RISE;
+	if (level_db > SILENCE_DB && (level_db > floor_db + threshold ||
+				      (rec->bands && level_db > floor_db + 3.0f)))
+		rec->flags |= ACTINDEX_ACTIVE;
+	fwrite(rec, sizeof(*rec), 1, out);
+	nblk++;
+	if (rec->flags & ACTINDEX_ACTIVE)
+		nactive++;
+}
+
+static void flush_prime(FILE *out)
+{
+	unsigned int i;
+
+	floor_db = 0;
+	for (i = 0; i < nprime; i++)
+		if (prime_db[i] < floor_db)
+			floor_db = prime_db[i];
+	for (i = 0; i < nprime; i++)
+		judge(&prime_rec[i], prime_db[i], out);
+	nprime = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static const char usage_str[] = "actindex-ng\n"
+"Builds an activity index for a raw recording, for use with multimon-ng --index\n"
+"usage: %s [options] recording.raw [index]\n"
+"  -r <rate>  : sample rate of the recording (default: 22050)\n"
+"  -b <ms>    : block length in ms (default: 100)\n"
+"  -t <dB>    : level above the noise floor that counts as active (default: 10)\n"
+"  -l         : list the active ranges of an existing index instead\n"
+"  -h         : this help\n"
+"  The index is written to recording.raw.idx unless given.\n";
+
+static void list_ranges(const char *fname)
+{
+	struct actindex_header hdr;
+	struct actindex_block *blk;
+	uint64_t count, pos = 0, start, end, active = 0;
+	long size;
+	FILE *f;
+
+	if (!(f = fopen(fname, "rb"))) {
+		perror("fopen");
+		exit(10);
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != ACTINDEX_MAGIC ||
+	    hdr.version != ACTINDEX_VERSION || hdr.record_size != sizeof(*blk)) {
+		fprintf(stderr, "%s is not an activity index\n", fname);
+		exit(10);
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	count = (size - hdr.header_size) / sizeof(*blk);
+	if (!(blk = malloc(count * sizeof(*blk) + 1))) {
+		perror("malloc");
+		exit(10);
+	}
+	fseek(f, hdr.header_size, SEEK_SET);
+	count = fread(blk, sizeof(*blk), count, f);
+	fclose(f);
+
+	while (actindex_next_range(blk, count, &pos, 0, &start, &end)) {
+		double bs = (double)hdr.block_len / hdr.sample_rate;
+		printf("%12.1f %12.1f\n", start * bs, end * bs);
+		active += end - start;
+	}
+	fprintf(stderr, "%llu of %llu blocks active\n",
+		(unsigned long long)active, (unsigned long long)count);
+	free(blk);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int sample_rate = 22050, block_ms = 100;
+	int c, list = 0, primed = 0;
+	struct actindex_header hdr;
+	struct actindex_block rec;
+	struct bank bank;
+	char idxname[4096];
+	short *buf;
+	float *fbuf;
+	FILE *in, *out;
+	size_t n, i;
+
+	while ((c = getopt(argc, argv, "r:b:t:lh")) != -1) {
+		switch (c) {
+		case 'r':
+			sample_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			block_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			threshold = strtof(optarg, NULL);
+			break;
+		case 'l':
+			list = 1;
+			break;
+		default:
+			fprintf(stderr, usage_str, argv[0]);
+			exit(2);
+		}
+	}
+	if (optind >= argc || !sample_rate || !block_ms) {
+		fprintf(stderr, usage_str, argv[0]);
+		exit(2);
+	}
+	if (list) {
+		list_ranges(argv[optind]);
+		exit(0);
+	}
+	if (optind + 1 < argc)
+		snprintf(idxname, sizeof(idxname), "%s", argv[optind + 1]);
+	else
+		snprintf(idxname, sizeof(idxname), "%s.idx", argv[optind]);
+
+	if (!(in = fopen(argv[optind], "rb"))) {
+		perror("fopen");
+		exit(10);
+	}
+	if (!(out = fopen(idxname, "wb"))) {
+		perror("fopen");
+		exit(10);
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = ACTINDEX_MAGIC;
+	hdr.version = ACTINDEX_VERSION;
+	hdr.header_size = sizeof(hdr);
+	hdr.sample_rate = sample_rate;
+	hdr.block_len = (uint64_t)sample_rate * block_ms / 1000;
+	hdr.record_size = sizeof(rec);
+	if (!hdr.block_len) {
+		fprintf(stderr, usage_str, argv[0]);
+		exit(2);
+	}
+	bank_init(&bank, sample_rate, hdr.band_hz);
+	fwrite(&hdr, sizeof(hdr), 1, out);
+
+	buf = malloc(hdr.block_len * sizeof(*buf));
+	fbuf = malloc(hdr.block_len * sizeof(*fbuf));
+	if (!buf || !fbuf) {
+		perror("malloc");
+		exit(10);
+	}
+
+	/* a short last block is still indexed */
+	while ((n = fread(buf, sizeof(*buf), hdr.block_len, in)) > 0) {
+		float energy = 0, level_db, share;
+		int clipped = 0;
+		unsigned int b;
+
+		for (i = 0; i < n; i++) {
+			fbuf[i] = buf[i] * (1.0f/32768.0f);
+			energy += fbuf[i] * fbuf[i];
+			clipped |= buf[i] == 32767 || buf[i] == -32768;
+		}
+		memset(&bank.pwr, 0, sizeof(bank.pwr));
+		bank_run(&bank, fbuf, n);
+
+		energy /= n;
+		level_db = 10.0f * log10f(energy + 1e-14f);
+
+		memset(&rec, 0, sizeof(rec));
+		c = 2.0f * (level_db + 127.5f) + 0.5f;
+		rec.level = c < 0 ? 0 : c > 255 ? 255 : c;
+		if (level_db > SILENCE_DB)
+			for (b = 0; b < ACTINDEX_BANDS; b++) {
+				share = BAND(bank.pwr, b) / (n * energy);
+				if (share > BAND_SHARE)
+					rec.bands |= 1 << b;
+			}
+		if (clipped)
+			rec.flags |= ACTINDEX_CLIPPED;
+
+		if (primed) {
+			judge(&rec, level_db, out);
+			continue;
+		}
+		prime_rec[nprime] = rec;
+		prime_db[nprime++] = level_db;
+		if (nprime == FLOOR_PRIME) {
+			flush_prime(out);
+			primed = 1;
+		}
+	}
+	flush_prime(out);
+	if (ferror(in) || fclose(out)) {
+		perror("actindex");
+		exit(4);
+	}
+	fclose(in);
+	fprintf(stderr, "%s: %llu of %llu blocks active\n", idxname,
+		(unsigned long long)nactive, (unsigned long long)nblk);
+	free(buf);
+	free(fbuf);
+	exit(0);
+}
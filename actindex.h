@@ -0,0 +1,95 @@
+/*
+ *      actindex.h -- activity index sidecar for long raw recordings
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#ifndef _ACTINDEX_H
+#define _ACTINDEX_H
+
+#include <stdint.h>
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * An index file is one header followed by one record for every
+ * 'block_len' samples of the raw recording (100 ms by default), all in
+ * host byte order. Block n covers samples n*block_len ... (n+1)*block_len-1
+ * of the recording.
+ *
+ * 'level' is the block's RMS level in half dB steps above -127.5 dBFS,
+ * 'bands' has bit b set when band b (centred on band_hz[b]) carries a
+ * large share of the block's energy, as tones and FSK carriers do.
+ * ACTINDEX_ACTIVE is the builder's verdict, taking the noise floor of
+ * the recording into account.
+ */
+
+#define ACTINDEX_MAGIC    0x49414d4du  /* "MMAI" */
+#define ACTINDEX_VERSION  1
+#define ACTINDEX_BANDS    16
+
+#define ACTINDEX_ACTIVE   0x01         /* level well above the noise floor or tone present */
+#define ACTINDEX_CLIPPED  0x02         /* block contains full scale samples */
+
+struct actindex_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;          /* offset of the first record */
+	uint32_t sample_rate;
+	uint32_t block_len;            /* samples per record */
+	uint32_t record_size;
+	uint16_t band_hz[ACTINDEX_BANDS];
+};
+
+struct actindex_block {
+	uint8_t level;
+	uint8_t flags;
+	uint16_t bands;
+};
+
+#define ACTINDEX_LEVEL_DB(l) ((l) * 0.5f - 127.5f)
+
+/*
+ * Find the next run of active blocks at or after *pos, widened by 'pad'
+ * blocks on either side. Runs closer than that are merged. Returns 0 when
+ * there is none, otherwise [*start, *end) and advances *pos past it.
+ */
+static inline int actindex_next_range(const struct actindex_block *blk, uint64_t nblk,
+				      uint64_t *pos, uint64_t pad,
+				      uint64_t *start, uint64_t *end)
+{
+	uint64_t i = *pos, quiet;
+
+	while (i < nblk && !(blk[i].flags & ACTINDEX_ACTIVE))
+		i++;
+	if (i >= nblk)
+		return 0;
+	*start = i > pad ? i - pad : 0;
+	if (*start < *pos)
+		*start = *pos;
+	for (quiet = 0; i < nblk && quiet <= 2*pad; i++)
+		quiet = (blk[i].flags & ACTINDEX_ACTIVE) ? 0 : quiet + 1;
+	/* i is one past the last block looked at, quiet of them were inactive */
+	*end = i - quiet + pad;
+	if (*end > nblk)
+		*end = nblk;
+	*pos = *end;
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+#endif /* _ACTINDEX_H */
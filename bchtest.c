@@ -0,0 +1,262 @@
+/*
+ *      bchtest.c -- checks the table driven BCH decoders against the
+ *                   reference decoders they replaced
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "BCHCode.h"
+#include "BCH3121.h"
+#include "BCH26.h"
+
+/* ---------------------------------------------------------------------- */
+
+static unsigned long checked, failed;
+
+static void fail(const char *what, uint32_t word, uint32_t err)
+{
+	if (failed++ < 10)
+		fprintf(stderr, "%s: word %08x error %08x\n", what, word, err);
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * FLEX BCH(31,21): bit j of a word is the coefficient of x^(30-j), data in
+ * bits 0..20, parity in 21..30. BCHCode_Decode() takes the coefficients
+ * as ints, recd[i] being that of x^i.
+ */
+static struct BCHCode *flex_ref;
+
+static uint32_t flex_encode(uint32_t data)
+{
+	uint64_t r = 0;
+	uint32_t cw = data;
+	int i;
+
+	for (i = 0; i < 21; i++)
+		if (data & (1u << i))
+			r |= 1ull << (30 - i);
+	for (i = 30; i >= 10; i--)
+		if (r & (1ull << i))
+			r ^= 0x769ull << (i - 10);      /* x^10+x^9+x^8+x^6+x^5+x^3+1 */
+	for (i = 0; i < 10; i++)
+		if (r & (1ull << i))
+			cw |= 1u << (30 - i);
+	return cw;
+}
+
+static int flex_ref_decode(uint32_t *word)
+{
+	int recd[31], i;
+
+	for (i = 0; i < 31; i++)
+		recd[i] = (*word >> (30 - i)) & 1;
+	if (BCHCode_Decode(flex_ref, recd))
+		return -1;
+	for (*word = 0, i = 0; i < 31; i++)
+		*word |= (uint32_t)recd[i] << (30 - i);
+	return 0;
+}
+
+/*
+ * Both decoders only look at the syndrome, so every error pattern is
+ * compared with BCHCode_Decode() on a spread of codewords, and
+ * bch3121_correct() alone has to restore every codeword from every 0, 1
+ * and 2 bit error.
+ */
+static void test_bch3121(void)
+{
+	int p[6] = { 1, 0, 1, 0, 0, 1 };
+	uint32_t data, cw, err, w, r;
+	int i, j, n;
+
+	flex_ref = BCHCode_New(p, 5, 31, 21, 2);
+	bch3121_init();
+	for (data = 0; data < (1u << 21); data++) {
+		cw = flex_encode(data);
+		for (i = -1; i < 31; i++)
+			for (j = i; j < 31; j++) {
+				if (j == i && i >= 0)
+					continue;
+				err = (i >= 0 ? 1u << i : 0) | (j >= 0 ? 1u << j : 0);
+				/* bit 31 is not part of the codeword */
+				w = cw ^ err ^ ((data & 1) << 31);
+				n = bch3121_correct(&w);
+				checked++;
+				if (n != __builtin_popcount(err) || w != cw)
+					fail("bch3121_correct", cw, err);
+				if (data % 4099)
+					continue;
+				r = (cw ^ err) & 0x7fffffff;
+				if (flex_ref_decode(&r) || r != cw)
+					fail("BCHCode_Decode", cw, err);
+			}
+	}
+	BCHCode_Delete(flex_ref);
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * CIR BCH(26,16): the bit serial decoder BCH26.c used to have, kept
+ * as it was as the reference for bch26_correct() and bch26_decode_units().
+ * It returns 3 for an uncorrectable unit.
+ */
+
+#define gx 0x05B9<<(26-11)
+
+static const unsigned int CheckMatrix[26][2] = {
+        {119, 33554432},
+        {743, 16777216},
+        {943, 8388608},
+        {779, 4194304},
+        {857, 2097152},
+        {880, 1048576},
+        {440, 524288},
+        {220, 262144},
+        {110, 131072},
+        {55,  65536},
+        {711, 32768},
+        {959, 16384},
+        {771, 8192},
+        {861, 4096},
+        {882, 2048},
+        {441, 1024},
+        {512, 512},
+        {256, 256},
+        {128, 128},
+        {64,  64},
+        {32,  32},
+        {16,  16},
+        {8,   8},
+        {4,   4},
+        {2,   2},
+        {1,   1}
+};
+
+static unsigned int decode_BCH_26_16(unsigned int code, unsigned int *value) {
+    // this code is adapted from: https://blog.csdn.net/u012750235/article/details/84622161
+    unsigned int decode = 0;
+    unsigned int res;
+    decode = code;
+    //2.1 calculate remainder
+    for (int i = 0; i < 16; i++) {
+        if ((code & 0x2000000) != 0) {
+            code ^= gx;
+        }
+        code = code << 1;
+    }
+    res = code >> (26 - 10);
+    if (res == 0) {
+        *value = decode;
+        return 0;
+    }
+    //2.2 correct one bit error
+    for (int i = 0; i < 26; i++) {
+        if (res == CheckMatrix[i][0]) {
+            decode = decode ^ CheckMatrix[i][1];
+            *value = decode;
+            return 1;
+        }
+    }
+    //2.3 correct two bit error
+    for (int i = 0; i < 26; i++) {
+        for (int j = i + 1; j < 26; j++) {
+            if (res == (CheckMatrix[i][0] ^ CheckMatrix[j][0])) {
+                decode = decode ^ CheckMatrix[i][1] ^ CheckMatrix[j][1];
+                *value = decode;
+                return 2;
+            }
+        }
+    }
+    return 3;
+}
+
+static uint32_t bch26_encode(uint32_t data)
+{
+	uint32_t r = data << 10;
+	int i;
+
+	for (i = 25; i >= 10; i--)
+		if (r & (1u << i))
+			r ^= 0x5b9u << (i - 10);        /* x^10+x^8+x^7+x^5+x^4+x^3+1 */
+	return data << 10 | r;
+}
+
+/*
+ * Both decoders only look at the syndrome of a unit, and units 0..1023
+ * have every syndrome there is, so those must match exactly. Random units
+ * and packed frames of random codewords with up to three errors per unit
+ * check the rest: the unit handling and the bit unpacking.
+ */
+static void test_bch26(void)
+{
+	unsigned char bits[130 * 26 / 8 + 4], ref_data[260], data[260];
+	unsigned int v, r, nunits, good, ref_fixed, fixed, u, k, b;
+	uint32_t units[130], unit, w;
+	long t;
+	int n;
+
+	bch26_init();
+	srand(1);
+	for (t = 0; t < 1024 + (1L << 22); t++) {
+		unit = w = t < 1024 ? t : ((uint32_t)rand() ^ (uint32_t)rand() << 13) & 0x3ffffff;
+		r = decode_BCH_26_16(w, &v);
+		n = bch26_correct(&w);
+		checked++;
+		if ((r == 3) != (n < 0) || (r != 3 && (r != (unsigned int)n || v != w)))
+			fail("bch26_correct", unit, 0);
+	}
+	for (t = 0; t < 20000; t++) {
+		nunits = 1 + rand() % 130;
+		memset(bits, 0, sizeof(bits));
+		for (u = 0; u < nunits; u++) {
+			units[u] = bch26_encode(rand() & 0xffff);
+			for (k = rand() % (t & 1 ? 4 : 3); k > 0; k--)
+				units[u] ^= 1u << (rand() % 26);
+			for (b = 0; b < 26; b++)
+				if (units[u] & (1u << (25 - b)))
+					bits[(u * 26 + b) >> 3] |= 0x80 >> ((u * 26 + b) & 7);
+		}
+		for (good = ref_fixed = 0; good < nunits; good++) {
+			if ((r = decode_BCH_26_16(units[good], &v)) == 3)
+				break;
+			ref_fixed += r;
+			ref_data[2 * good] = v >> 18;
+			ref_data[2 * good + 1] = v >> 10;
+		}
+		checked++;
+		if (bch26_decode_units(bits, nunits, data, &fixed) != good || fixed != ref_fixed ||
+		    memcmp(data, ref_data, 2 * good))
+			fail("bch26_decode_units", nunits, good);
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+
+int main(void)
+{
+	test_bch3121();
+	test_bch26();
+	printf("%lu words checked, %lu failed\n", checked, failed);
+	return failed != 0;
+}
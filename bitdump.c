@@ -0,0 +1,351 @@
+/*
+ *      bitdump.c -- record and replay the bit streams between L1 and L2
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include "multimon.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * File format, all integers little endian:
+ *
+ *   header   "MMBD", version (1 byte), 3 reserved bytes, sample rate (4 bytes)
+ *   'S'      stream: id, layer 2 (enum bitdump_l2), bits per symbol,
+ *            name length, name of the demodulator
+ *   'B'      bits: id, symbol count (2 bytes), sample offset (8 bytes),
+ *            symbols packed MSB first
+ *
+ * The sample offset is that of the first symbol of the record (FLEX: of
+ * the audio block it was sliced from), counted from the start of the
+ * input. A stream is declared before its first 'B' record.
+ */
+
+#define BITDUMP_MAGIC   "MMBD"
+#define BITDUMP_VERSION 1
+#define MAX_STREAMS     32
+#define MAX_SYMS        4096
+
+bool bitdump_enabled = false;
+
+static FILE *dump;
+static uint64_t block_offset;
+static unsigned int nstreams;
+
+static struct stream {
+    const struct demod_state *s;
+    unsigned char l2;
+    unsigned char bps;
+    unsigned int count;
+    unsigned int first;         /* offset of the first symbol in the block */
+    unsigned char buf[MAX_SYMS / 4];
+} streams[MAX_STREAMS];
+
+static void put_le(unsigned char *p, uint64_t v, unsigned int n)
+{
+    while (n--) {
+        *p++ = v;
+        v >>= 8;
+    }
+}
+
+static uint64_t get_le(const unsigned char *p, unsigned int n)
+{
+    uint64_t v = 0;
+
+    while (n--)
+        v = (v << 8) | p[n];
+    return v;
+}
+
+static void write_or_die(const void *p, size_t len)
+{
+    if (fwrite(p, 1, len, dump) != len) {
+        perror("bitdump");
+        exit(4);
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void bitdump_open(const char *fname, unsigned int sample_rate)
+{
+    unsigned char hdr[12];
+
+    if (!(dump = fopen(fname, "wb"))) {
+        perror("bitdump");
+        exit(10);
+    }
+    memcpy(hdr, BITDUMP_MAGIC, 4);
+    hdr[4] = BITDUMP_VERSION;
+    hdr[5] = hdr[6] = hdr[7] = 0;
+    put_le(hdr + 8, sample_rate, 4);
+    write_or_die(hdr, sizeof(hdr));
+    bitdump_enabled = true;
+}
+
+static void flush_stream(struct stream *st)
+{
+    unsigned char hdr[12];
+
+    if (!st->count)
+        return;
+    hdr[0] = 'B';
+    hdr[1] = st - streams;
+    put_le(hdr + 2, st->count, 2);
+    put_le(hdr + 4, block_offset + st->first, 8);
+    write_or_die(hdr, sizeof(hdr));
+    write_or_die(st->buf, (st->count * st->bps + 7) / 8);
+    st->count = 0;
+}
+
+static struct stream *new_stream(struct demod_state *s, enum bitdump_l2 l2)
+{
+    struct stream *st;
+    unsigned char hdr[5];
+    size_t len = strlen(s->dem_par->name);
+
+    if (nstreams >= MAX_STREAMS) {
+        fprintf(stderr, "bitdump: too many streams\n");
+        exit(4);
+    }
+    st = &streams[nstreams];
+    st->s = s;
+    st->l2 = l2;
+    st->bps = l2 == BITDUMP_FLEX ? 2 : 1;
+    st->count = 0;
+    hdr[0] = 'S';
+    hdr[1] = nstreams++;
+    hdr[2] = st->l2;
+    hdr[3] = st->bps;
+    hdr[4] = len;
+    write_or_die(hdr, sizeof(hdr));
+    write_or_die(s->dem_par->name, len);
+    return st;
+}
+
+static struct stream *find_stream(struct demod_state *s, enum bitdump_l2 l2)
+{
+    struct stream *st;
+
+    /* a handful of streams at most, the last one used is the likely one */
+    for (st = streams + nstreams; st-- > streams; )
+        if (st->s == s)
+            return st;
+    return new_stream(s, l2);
+}
+
+static void put_sym(struct stream *st, unsigned int sym, unsigned int offs)
+{
+    unsigned int pos;
+
+    if (!st->count)
+        st->first = offs;
+    pos = st->count * st->bps;
+    if (!(pos & 7))
+        st->buf[pos >> 3] = 0;
+    st->buf[pos >> 3] |= (sym & ((1u << st->bps) - 1)) << (8 - st->bps - (pos & 7));
+    if (++st->count == MAX_SYMS)
+        flush_stream(st);
+}
+
+void bitdump_put(struct demod_state *s, enum bitdump_l2 l2, unsigned int sym)
+{
+    put_sym(find_stream(s, l2), sym, 0);
+}
+
+void bitdump_putbits(struct demod_state *s, enum bitdump_l2 l2, const unsigned char *bits,
+                     const unsigned short *offs, unsigned int nbits)
+{
+    struct stream *st = find_stream(s, l2);
+    unsigned int i;
+
+    for (i = 0; i < nbits; i++)
+        put_sym(st, rxbits_bit(bits, i), offs[i]);
+}
+
+/*
+ * Called once the demodulators are done with a block of len samples.
+ */
+void bitdump_block(unsigned int len)
+{
+    unsigned int i;
+
+    for (i = 0; i < nstreams; i++)
+        flush_stream(&streams[i]);
+    block_offset += len;
+}
+
+void bitdump_close(void)
+{
+    if (!dump)
+        return;
+    bitdump_block(0);
+    if (fclose(dump))
+        perror("bitdump");
+    dump = NULL;
+    bitdump_enabled = false;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void rxbits_init(struct demod_state *s,
+                 void (*l2)(struct demod_state *s, const unsigned char *bits, unsigned int nbits),
+                 enum bitdump_l2 dump)
+{
+    s->rxbits.l2 = l2;
+    s->rxbits.dump = dump;
+    s->rxbits.n = 0;
+}
+
+void rxbits_flush(struct demod_state *s)
+{
+    struct rxbits *rb = &s->rxbits;
+    unsigned int i;
+
+    if (!rb->n)
+        return;
+    if (bitdump_enabled && rb->dump)
+        bitdump_putbits(s, rb->dump, rb->bits, rb->offs, rb->n);
+    for (i = 0; i < rb->n; i++)
+        verbprintf(9, " %c ", '0' + rxbits_bit(rb->bits, i));
+    rb->l2(s, rb->bits, rb->n);
+    rb->n = 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void replay_sym(struct demod_state *s, unsigned char l2, unsigned int sym)
+{
+    switch (l2) {
+    case BITDUMP_HDLC:
+        hdlc_rxbit(s, sym);
+        break;
+    case BITDUMP_POCSAG:
+        pocsag_rxbit(s, sym);
+        break;
+    case BITDUMP_UART:
+        uart_rxbit(s, sym);
+        break;
+    case BITDUMP_CLIP:
+        clip_rxbit(s, sym);
+        break;
+    case BITDUMP_FMS:
+        fms_rxbit(s, sym);
+        break;
+    case BITDUMP_CIR:
+        cir_rxbit(s, sym);
+        break;
+    case BITDUMP_FLEX:
+        flex_rxsym(s, sym);
+        break;
+    }
+}
+
+static void truncated(const char *fname)
+{
+    fprintf(stderr, "bitdump: %s is truncated or corrupt\n", fname);
+    exit(4);
+}
+
+/*
+ * Feed a recorded dump straight into the layer 2 decoders of the enabled
+ * demodulators. Streams of demodulators that are not enabled are skipped.
+ */
+void bitdump_replay(const char *fname, struct demod_state *(*find)(const char *name))
+{
+    struct {
+        struct demod_state *s;
+        unsigned char l2, bps;
+    } map[256];
+    unsigned char hdr[12], buf[MAX_SYMS / 4], name[256];
+    unsigned int count, i, shift, mask;
+    uint64_t offset;
+    FILE *f;
+    int c;
+
+    if (!(f = strcmp(fname, "-") ? fopen(fname, "rb") : stdin)) {
+        perror("bitdump");
+        exit(10);
+    }
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || memcmp(hdr, BITDUMP_MAGIC, 4) ||
+        hdr[4] != BITDUMP_VERSION) {
+        fprintf(stderr, "bitdump: %s is not a bit stream dump\n", fname);
+        exit(4);
+    }
+    verbprintf(2, "bitdump: recorded at %u Hz\n", (unsigned int)get_le(hdr + 8, 4));
+    memset(map, 0, sizeof(map));
+
+    while ((c = getc(f)) != EOF) {
+        switch (c) {
+        case 'S':
+            if (fread(hdr, 1, 4, f) != 4 || fread(name, 1, hdr[3], f) != hdr[3])
+                truncated(fname);
+            name[hdr[3]] = 0;
+            map[hdr[0]].s = find((char *)name);
+            map[hdr[0]].l2 = hdr[1];
+            map[hdr[0]].bps = hdr[2];
+            if (!map[hdr[0]].s)
+                verbprintf(1, "bitdump: %s not enabled, skipping its bits\n", name);
+            /* only 1 (bits) and 2 (FLEX symbols) are ever written */
+            if (hdr[2] != 1 && hdr[2] != 2)
+                truncated(fname);
+            break;
+
+        case 'B':
+            if (fread(hdr, 1, 11, f) != 11)
+                truncated(fname);
+            count = get_le(hdr + 1, 2);
+            offset = get_le(hdr + 3, 8);
+            if (!map[hdr[0]].bps || count > MAX_SYMS)
+                truncated(fname);
+            i = (count * map[hdr[0]].bps + 7) / 8;
+            if (i > sizeof(buf) || fread(buf, 1, i, f) != i)
+                truncated(fname);
+#ifdef KISS_OUTPUT
+            /* no process_buffer() here to take on clients and hand over frames */
+            if (kiss_enabled)
+                kiss_poll();
+#endif
+            if (!map[hdr[0]].s)
+                break;
+            verbprintf(3, "bitdump: %u symbols at sample %llu\n",
+                       count, (unsigned long long)offset);
+            if (map[hdr[0]].l2 == BITDUMP_HDLC && map[hdr[0]].bps == 1) {
+                /* already packed the way hdlc_rxbits() takes them */
+                hdlc_rxbits(map[hdr[0]].s, buf, count);
+                break;
+            }
+            mask = (1u << map[hdr[0]].bps) - 1;
+            for (i = 0; i < count; i++) {
+                shift = i * map[hdr[0]].bps;
+                replay_sym(map[hdr[0]].s, map[hdr[0]].l2,
+                           (buf[shift >> 3] >> (8 - map[hdr[0]].bps - (shift & 7))) & mask);
+            }
+            break;
+
+        default:
+            truncated(fname);
+        }
+    }
+    if (f != stdin)
+        fclose(f);
+}
@@ -24,32 +24,36 @@
 #include <string.h>
 #include "BCH26.h"
 
-void cir_init(struct demod_state *s) {
-    memset(&s->l2.uart, 0, sizeof(s->l2.uart));
-    s->l2.cirfsk.rxbytes = 0;
-    s->l2.cirfsk.padding = 0;
-    s->l2.cirfsk.rxbitstream = 0;
-    s->l2.cirfsk.rxbitcount = 0;
-}
+// CRC-16/XMODEM: polynomial 0x1021, MSB first, starts at 0
+static uint16_t crc_tab[256];
 
+static void crc16_init(void) {
+    unsigned int i, j, crc;
 
-unsigned short crc16(unsigned char *ptr, int count) {
-    int crc;
-    char i;
-    crc = 0;
-    while (--count >= 0) {
-        crc = crc ^ (int) *ptr++ << 8;
-        i = 8;
-        do {
-            if (crc & 0x8000)
-                crc = crc << 1 ^ 0x1021;
-            else
-                crc = crc << 1;
-        } while (--i);
+    for (i = 0; i < 256; i++) {
+        crc = i << 8;
+        for (j = 0; j < 8; j++)
+            crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+        crc_tab[i] = crc;
     }
-    return (crc);
 }
 
+static uint16_t crc16(const unsigned char *ptr, int count) {
+    uint16_t crc = 0;
+
+    while (--count >= 0)
+        crc = crc << 8 ^ crc_tab[(crc >> 8) ^ *ptr++];
+    return crc;
+}
+
+void cir_init(struct demod_state *s) {
+    memset(&s->l2.cirfsk, 0, sizeof(s->l2.cirfsk));
+    if (!crc_tab[1])
+        crc16_init();
+    bch26_init();
+}
+
+
 static void cir_display_package(unsigned char *buffer, uint16_t length) {
     uint16_t i;
     verbprintf(0, "CIRFSK(%d):", length);
@@ -59,10 +63,7 @@ static void cir_display_package(unsigned char *buffer, uint16_t length) {
     verbprintf(0, "\n");
 }
 
-uint16_t sync_count = 0;
-uint16_t last_bit = 0;
-
-void cir_rxbit(struct demod_state *s, unsigned char bit) {
+static void cir_bit(struct demod_state *s, unsigned char bit) {
     // According to standard TB/T 3052-2002
     // The basic wireless data frame is defined as following:
     // | bit sync (51bit) | frame sync (31bit) | mode char (8bit) | length = n (8bit) | ..payloads.. | crc16 (16bit) |
@@ -73,20 +74,20 @@ void cir_rxbit(struct demod_state *s, unsigned char bit) {
 
     // Part I Bit Sync
     if (s->l2.cirfsk.rxbitcount == 0) {
-        if (bit != last_bit) {
-            sync_count++;
+        if (bit != s->l2.cirfsk.last_bit) {
+            s->l2.cirfsk.sync_count++;
         } else {
-            if (sync_count >= 44) {
-                verbprintf(1, "CIR> Bit Sync len: %d\n", sync_count);
+            if (s->l2.cirfsk.sync_count >= 44) {
+                verbprintf(1, "CIR> Bit Sync len: %d\n", s->l2.cirfsk.sync_count);
                 s->l2.cirfsk.rxbitstream = bit; // reset RX FSM buffer
                 s->l2.cirfsk.rxbitcount = 2;  // > 1 means we have a valid SYNC
                 s->l2.cirfsk.rxptr = s->l2.cirfsk.rxbuf; // reset RX dump buffer
-            } else if (sync_count >= 30) {
-                verbprintf(2, "CIR> Bit Sync break at len: %d\n\n", sync_count);
+            } else if (s->l2.cirfsk.sync_count >= 30) {
+                verbprintf(2, "CIR> Bit Sync break at len: %d\n\n", s->l2.cirfsk.sync_count);
             }
-            sync_count = 0;
+            s->l2.cirfsk.sync_count = 0;
         }
-        last_bit = bit;
+        s->l2.cirfsk.last_bit = bit;
     }
         // Part II Frame Sync & Length Read
     else if (s->l2.cirfsk.rxbitcount >= 1) {
@@ -95,12 +96,7 @@ void cir_rxbit(struct demod_state *s, unsigned char bit) {
         if (s->l2.cirfsk.rxbitcount == 32) {
             // Check frame sync
             uint32_t frame_sync = 0x0dd4259f;
-            uint8_t bit_error = 0;
-            for (uint8_t i = 0; i < 32; i++) {
-                if ((s->l2.cirfsk.rxbitstream >> i & 1) != (frame_sync >> i & 1)) {
-                    bit_error++;
-                }
-            }
+            uint8_t bit_error = __builtin_popcount(s->l2.cirfsk.rxbitstream ^ frame_sync);
             if (bit_error < 3) {
                 verbprintf(1, "CIR> Frame Sync OK (bit error:%d)\n", bit_error);
             } else {
@@ -110,50 +106,73 @@ void cir_rxbit(struct demod_state *s, unsigned char bit) {
             }
             s->l2.cirfsk.rxbitstream = 0;
             // Part III Receive Payload
-        } else if (s->l2.cirfsk.rxbitcount >= 58 && (s->l2.cirfsk.rxbitcount - 58) % 26 == 0) {
-            uint32_t decoded;
-            uint8_t errors = decode_BCH_26_16(s->l2.cirfsk.rxbitstream, &decoded);
+        } else if (s->l2.cirfsk.rxbitcount == 58) {
+            // the first unit carries the length, the rest is decoded once it is all in
+            uint32_t decoded = s->l2.cirfsk.rxbitstream;
+            int errors = bch26_correct(&decoded);
+            if (errors < 0) {
+                s->l2.cirfsk.rxbitcount = 0;
+                verbprintf(2, "CIR> %d FEC too many error\n\n", 0);
+                return;
+            }
             decoded >>= 10u;
-            if (errors >= 3) {
+            uint8_t length = (decoded & 0x000000ffu);
+            s->l2.cirfsk.padding = length % 2;
+            length = length + length % 2;
+            s->l2.cirfsk.rxbytes = length + 2;
+            if (length == 0) {
                 s->l2.cirfsk.rxbitcount = 0;
-                verbprintf(2, "CIR> %d FEC too many error\n\n", s->l2.cirfsk.rxptr - s->l2.cirfsk.rxbuf);
+                verbprintf(1, "CIR> zero length\n\n");
+                return;
+            }
+            verbprintf(1, "CIR> rx:%d (%d padding) \n", length, s->l2.cirfsk.padding);
+            s->l2.cirfsk.rxbuf[0] = decoded >> 8;
+            s->l2.cirfsk.rxbuf[1] = decoded & 0xff;
+            s->l2.cirfsk.rxptr = s->l2.cirfsk.rxbuf + 2;
+            s->l2.cirfsk.rxunits = length / 2;
+            verbprintf(3, "CIR> 0 0x%04x -> 0x%04x error:%d\n", s->l2.cirfsk.rxbitstream >> 10, decoded, errors);
+            s->l2.cirfsk.rxbitstream = 0;
+        } else if (s->l2.cirfsk.rxbitcount > 58) {
+            unsigned int pos = s->l2.cirfsk.rxbitcount - 59;
+            if (!(pos & 7))
+                s->l2.cirfsk.rxraw[pos >> 3] = 0;
+            s->l2.cirfsk.rxraw[pos >> 3] |= bit << (7 - (pos & 7));
+            if (pos + 1 < 26 * s->l2.cirfsk.rxunits)
                 return;
+            s->l2.cirfsk.rxbitcount = 0;
+            unsigned int fixed;
+            unsigned int units = bch26_decode_units(s->l2.cirfsk.rxraw, s->l2.cirfsk.rxunits,
+                                                    s->l2.cirfsk.rxptr, &fixed);
+            if (units < s->l2.cirfsk.rxunits) {
+                verbprintf(2, "CIR> %d FEC too many error\n\n", 2 + 2 * units);
+                return;
+            }
+            verbprintf(3, "CIR> %u units, %u bits corrected\n", units, fixed);
+            // receive completed, check crc
+            verbprintf(3, "CIR> padding:%d\n", s->l2.cirfsk.padding);
+            uint8_t padding = s->l2.cirfsk.padding;
+            uint16_t crc = crc16(s->l2.cirfsk.rxbuf, s->l2.cirfsk.rxbytes - 2 - padding);
+            verbprintf(2, "CIR> crc:%04x ", crc);
+
+            if ((((crc >> 8) & 0x00ff) == s->l2.cirfsk.rxbuf[s->l2.cirfsk.rxbytes - 2 - padding]) && \
+                ((crc & 0x00ff) == s->l2.cirfsk.rxbuf[s->l2.cirfsk.rxbytes - 1 - padding])) {
+                verbprintf(2, "crc ok\n");
+                cir_display_package(s->l2.cirfsk.rxbuf, s->l2.cirfsk.rxbytes - padding);
             } else {
-                if (s->l2.cirfsk.rxbitcount == 58) {
-                    uint8_t length = (decoded & 0x000000ffu);
-                    s->l2.cirfsk.padding = length % 2;
-                    length = length + length % 2;
-                    s->l2.cirfsk.rxbytes = length + 2;
-                    if (length == 0) {
-                        s->l2.cirfsk.rxbitcount = 0;
-                        verbprintf(1, "CIR> zero length\n\n");
-                        return;
-                    }
-                    verbprintf(1, "CIR> rx:%d (%d padding) \n", length, s->l2.cirfsk.padding);
-                }
-                // save data
-                for (uint8_t i = 0; i < 2; i++)
-                    *(s->l2.cirfsk.rxptr)++ = (decoded >> (1 - i) * 8) & 0x000000ff;
-                verbprintf(3, "CIR> %d 0x%04x -> 0x%04x error:%d\n", s->l2.cirfsk.rxptr - s->l2.cirfsk.rxbuf - 2, \
-                           s->l2.cirfsk.rxbitstream >> 10, decoded, errors);
-                s->l2.cirfsk.rxbitstream = 0;
-                // if receive completed, check crc
-                if (s->l2.cirfsk.rxptr - s->l2.cirfsk.rxbuf == s->l2.cirfsk.rxbytes) {
-                    verbprintf(3, "CIR> padding:%d\n", s->l2.cirfsk.padding);
-                    uint8_t padding = s->l2.cirfsk.padding;
-                    uint16_t crc = crc16(s->l2.cirfsk.rxbuf, s->l2.cirfsk.rxbytes - 2 - padding);
-                    verbprintf(2, "CIR> crc:%04x ", crc);
-
-                    if ((((crc >> 8) & 0x00ff) == s->l2.cirfsk.rxbuf[s->l2.cirfsk.rxbytes - 2 - padding]) && \
-                        ((crc & 0x00ff) == s->l2.cirfsk.rxbuf[s->l2.cirfsk.rxbytes - 1 - padding])) {
-                        verbprintf(2, "crc ok\n");
-                        cir_display_package(s->l2.cirfsk.rxbuf, s->l2.cirfsk.rxbytes - padding);
-                    } else {
-                        verbprintf(2, "bad crc\n\n");
-                    }
-                    s->l2.cirfsk.rxbitcount = 0;
-                }
+                verbprintf(2, "bad crc\n\n");
             }
         }
     }
-}
\ No newline at end of file
+}
+
+void cir_rxbit(struct demod_state *s, unsigned char bit) {
+    bitdump_rx(s, BITDUMP_CIR, bit);
+    cir_bit(s, bit);
+}
+
+void cir_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits) {
+    unsigned int i;
+
+    for (i = 0; i < nbits; i++)
+        cir_bit(s, rxbits_bit(bits, i));
+}
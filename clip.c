@@ -398,7 +398,7 @@ void clip_init(struct demod_state *s)
 
 /* ---------------------------------------------------------------------- */
 
-void clip_rxbit(struct demod_state *s, int bit)
+static void clip_bit(struct demod_state *s, int bit)
 {
 	s->l2.uart.rxbitstream <<= 1;
 	s->l2.uart.rxbitstream |= !!bit;
@@ -442,4 +442,18 @@ void clip_rxbit(struct demod_state *s, int bit)
       	s->l2.uart.rxbitbuf >>= 1;
 }
 
+void clip_rxbit(struct demod_state *s, int bit)
+{
+	bitdump_rx(s, BITDUMP_CLIP, bit);
+	clip_bit(s, bit);
+}
+
+void clip_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits)
+{
+	unsigned int i;
+
+	for (i = 0; i < nbits; i++)
+		clip_bit(s, rxbits_bit(bits, i));
+}
+
 /* ---------------------------------------------------------------------- */
@@ -24,6 +24,8 @@
 #include "multimon.h"
 #include "filter.h"
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* ---------------------------------------------------------------------- */
@@ -50,6 +52,25 @@ static float corr_mark_q[CORRLEN];
 static float corr_space_i[CORRLEN];
 static float corr_space_q[CORRLEN];
 
+/*
+ * With afsk12_slicers > 1 the correlator energies are also handed to
+ * further slicers, each with its own DPLL and HDLC deframer, that weigh the
+ * 2200 Hz tone differently: by 2, 1/2, 4, 1/4, ... This makes up for the
+ * pre-/de-emphasis mismatch between transmitter and receiver, which can
+ * leave one tone far weaker than the other. A frame several slicers
+ * decode is printed once. The first slicer is the plain one.
+ */
+#define SLICERS_MAX 8
+
+unsigned int afsk12_slicers = 1;
+
+struct afsk12_slicers {
+	struct hdlc_dedup dedup;
+	unsigned int n;
+	float gain[SLICERS_MAX - 1];
+	struct demod_state s[SLICERS_MAX - 1];
+};
+
 /* ---------------------------------------------------------------------- */
 	
 static void afsk12_init(struct demod_state *s)
@@ -58,6 +79,7 @@ static void afsk12_init(struct demod_state *s)
 	int i;
 
 	hdlc_init(s);
+	rxbits_init(s, hdlc_rxbits, BITDUMP_HDLC);
 	memset(&s->l1.afsk12, 0, sizeof(s->l1.afsk12));
 	for (f = 0, i = 0; i < CORRLEN; i++) {
 		corr_mark_i[i] = cos(f);
@@ -69,15 +91,79 @@ static void afsk12_init(struct demod_state *s)
 		corr_space_q[i] = sin(f);
 		f += 2.0*M_PI*FREQ_SPACE/FREQ_SAMP;
 	}
+	if (afsk12_slicers > 1) {
+		struct afsk12_slicers *sl = calloc(1, sizeof(*sl));
+
+		if (!sl) {
+			perror("calloc");
+			exit(10);
+		}
+		sl->n = afsk12_slicers - 1;
+		sl->dedup.window = FREQ_SAMP;
+		s->l2.hdlc.dedup = &sl->dedup;
+		for (i = 0; i < (int)sl->n; i++) {
+			sl->gain[i] = ldexpf(1, i & 1 ? -(i + 1) / 2 : i / 2 + 1);
+			sl->s[i].dem_par = s->dem_par;
+			hdlc_init(&sl->s[i]);
+			/* only the plain slicer goes to --bitdump */
+			rxbits_init(&sl->s[i], hdlc_rxbits, 0);
+			sl->s[i].l2.hdlc.dedup = &sl->dedup;
+		}
+		s->l1.afsk12.slicers = sl;
+	}
+}
+
+static void afsk12_deinit(struct demod_state *s)
+{
+	struct afsk12_slicers *sl = s->l1.afsk12.slicers;
+	unsigned int i;
+
+	if (sl) {
+		for (i = 0; i < sl->n; i++)
+			s->l2.hdlc.rxfixed += sl->s[i].l2.hdlc.rxfixed;
+		verbprintf(1, "%s: %u slicers, %u frames, %u repeats dropped\n",
+			   s->dem_par->name, sl->n + 1, sl->dedup.frames, sl->dedup.repeats);
+	}
+	hdlc_deinit(s);
+	free(sl);
+	s->l1.afsk12.slicers = NULL;
 }
 
 /* ---------------------------------------------------------------------- */
 
-static void afsk12_demod(struct demod_state *s, buffer_t buffer, int length)
+static inline void afsk12_slice(struct demod_state *s, float f, unsigned int offs)
 {
-	float f;
 	unsigned char curbit;
 
+	s->l1.afsk12.dcd_shreg <<= 1;
+	s->l1.afsk12.dcd_shreg |= (f > 0);
+	verbprintf(10, "%c", '0'+(s->l1.afsk12.dcd_shreg & 1));
+	/*
+	 * check if transition; without branches, noise makes them random
+	 */
+	if ((s->l1.afsk12.dcd_shreg ^ (s->l1.afsk12.dcd_shreg >> 1)) & 1)
+		s->l1.afsk12.sphase += s->l1.afsk12.sphase < (0x8000u-(SPHASEINC/2)) ?
+			SPHASEINC/8 : -(SPHASEINC/8);
+	s->l1.afsk12.sphase += SPHASEINC;
+	if (s->l1.afsk12.sphase >= 0x10000u) {
+		s->l1.afsk12.sphase &= 0xffffu;
+		s->l1.afsk12.lasts <<= 1;
+		s->l1.afsk12.lasts |= s->l1.afsk12.dcd_shreg & 1;
+		curbit = (s->l1.afsk12.lasts ^ 
+			  (s->l1.afsk12.lasts >> 1) ^ 1) & 1;
+		rxbits_put(s, curbit, offs);
+	}
+}
+
+static void afsk12_demod(struct demod_state *s, buffer_t buffer, int length)
+{
+	struct afsk12_slicers *sl = s->l1.afsk12.slicers;
+	const float *start = buffer.fbuffer;
+	float mark, space;
+	unsigned int i;
+
+	if (sl)
+		sl->dedup.now += length;
 	if (s->l1.afsk12.subsamp) {
 		int numfill = SUBSAMP - s->l1.afsk12.subsamp;
 		if (length < numfill) {
@@ -89,40 +175,27 @@ static void afsk12_demod(struct demod_state *s, buffer_t buffer, int length)
 		s->l1.afsk12.subsamp = 0;
 	}
 	for (; length >= SUBSAMP; length -= SUBSAMP, buffer.fbuffer += SUBSAMP) {
-		f = fsqr(mac(buffer.fbuffer, corr_mark_i, CORRLEN)) +
-			fsqr(mac(buffer.fbuffer, corr_mark_q, CORRLEN)) -
-			fsqr(mac(buffer.fbuffer, corr_space_i, CORRLEN)) -
+		mark = fsqr(mac(buffer.fbuffer, corr_mark_i, CORRLEN)) +
+			fsqr(mac(buffer.fbuffer, corr_mark_q, CORRLEN));
+		space = fsqr(mac(buffer.fbuffer, corr_space_i, CORRLEN)) +
 			fsqr(mac(buffer.fbuffer, corr_space_q, CORRLEN));
-		s->l1.afsk12.dcd_shreg <<= 1;
-		s->l1.afsk12.dcd_shreg |= (f > 0);
-		verbprintf(10, "%c", '0'+(s->l1.afsk12.dcd_shreg & 1));
-		/*
-		 * check if transition
-		 */
-		if ((s->l1.afsk12.dcd_shreg ^ (s->l1.afsk12.dcd_shreg >> 1)) & 1) {
-			if (s->l1.afsk12.sphase < (0x8000u-(SPHASEINC/2)))
-				s->l1.afsk12.sphase += SPHASEINC/8;
-			else
-				s->l1.afsk12.sphase -= SPHASEINC/8;
-		}
-		s->l1.afsk12.sphase += SPHASEINC;
-		if (s->l1.afsk12.sphase >= 0x10000u) {
-			s->l1.afsk12.sphase &= 0xffffu;
-			s->l1.afsk12.lasts <<= 1;
-			s->l1.afsk12.lasts |= s->l1.afsk12.dcd_shreg & 1;
-			curbit = (s->l1.afsk12.lasts ^ 
-				  (s->l1.afsk12.lasts >> 1) ^ 1) & 1;
-			verbprintf(9, " %c ", '0'+curbit);
-			hdlc_rxbit(s, curbit);
-		}
+		afsk12_slice(s, mark - space, buffer.fbuffer - start);
+		if (sl)
+			for (i = 0; i < sl->n; i++)
+				afsk12_slice(&sl->s[i], mark - sl->gain[i] * space,
+					     buffer.fbuffer - start);
 	}
 	s->l1.afsk12.subsamp = length;
+	rxbits_flush(s);
+	if (sl)
+		for (i = 0; i < sl->n; i++)
+			rxbits_flush(&sl->s[i]);
 }
 
 /* ---------------------------------------------------------------------- */
 
 const struct demod_param demod_afsk1200 = {
-    "AFSK1200", true, FREQ_SAMP, CORRLEN, afsk12_init, afsk12_demod, NULL
+    "AFSK1200", true, FREQ_SAMP, CORRLEN, afsk12_init, afsk12_demod, afsk12_deinit
 };
 
 /* ---------------------------------------------------------------------- */
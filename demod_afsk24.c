@@ -59,6 +59,7 @@ static void afsk24_init(struct demod_state *s)
 	int i;
 
 	hdlc_init(s);
+	rxbits_init(s, hdlc_rxbits, BITDUMP_HDLC);
 	memset(&s->l1.afsk24, 0, sizeof(s->l1.afsk24));
 	for (f = 0, i = 0; i < CORRLEN; i++) {
 		corr_mark_i[i] = cos(f);
@@ -83,6 +84,7 @@ static void afsk24_init(struct demod_state *s)
 
 static void afsk24_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
 	float f;
 	unsigned char curbit;
 
@@ -110,16 +112,16 @@ static void afsk24_demod(struct demod_state *s, buffer_t buffer, int length)
 			s->l1.afsk24.lasts |= s->l1.afsk24.dcd_shreg & 1;
 			curbit = (s->l1.afsk24.lasts ^ 
 				  (s->l1.afsk24.lasts >> 1) ^ 1) & 1;
-			verbprintf(9, " %c ", '0'+curbit);
-			hdlc_rxbit(s, curbit);
+			rxbits_put(s, curbit, buffer.fbuffer - start);
 		}
 	}
+	rxbits_flush(s);
 }
 
 /* ---------------------------------------------------------------------- */
 
 const struct demod_param demod_afsk2400 = {
-    "AFSK2400", true, FREQ_SAMP, CORRLEN, afsk24_init, afsk24_demod, NULL
+    "AFSK2400", true, FREQ_SAMP, CORRLEN, afsk24_init, afsk24_demod, hdlc_deinit
 };
 
 /* ---------------------------------------------------------------------- */
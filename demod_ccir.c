@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int ccir_freq[16] = {
-    PHINC(1981), PHINC(1124), PHINC(1197), PHINC(1275),
-    PHINC(1358), PHINC(1446), PHINC(1540), PHINC(1640),
-    PHINC(1747), PHINC(1860), PHINC(2400), PHINC(930),
-    PHINC(2247), PHINC(991), PHINC(2110), PHINC(1055)
+    1981, 1124, 1197, 1275,
+    1358, 1446, 1540, 1640,
+    1747, 1860, 2400, 930,
+    2247, 991, 2110, 1055
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void ccir_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, ccir_freq);
 }
 
 static void ccir_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void ccir_deinit(struct demod_state *s)
 
 static void ccir_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, ccir_freq, demod_ccir.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_ccir.name);
 }
 
 const struct demod_param demod_ccir = {
-    "CCIR", true, SAMPLE_RATE, 0, ccir_init, ccir_demod, ccir_deinit
+    "CCIR", true, SAMPLE_RATE, SELCALL_OVERLAP, ccir_init, ccir_demod, ccir_deinit
 };
 
 
@@ -57,6 +57,7 @@ static void cirfsk_init(struct demod_state *s)
     int i;
 
     cir_init(s);
+    rxbits_init(s, cir_rxbits, BITDUMP_CIR);
     memset(&s->l1.fmsfsk, 0, sizeof(s->l1.fmsfsk));
     for (f = 0, i = 0; i < CORRLEN; i++) {
         corr_1_i[i] = cos(f);
@@ -74,6 +75,7 @@ static void cirfsk_init(struct demod_state *s)
 
 static void cirfsk_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+    const float *start = buffer.fbuffer;
     float f;
     unsigned char curbit;
 
@@ -108,11 +110,11 @@ static void cirfsk_demod(struct demod_state *s, buffer_t buffer, int length)
         if (s->l1.fmsfsk.sphase >= 0x10000u) {
             s->l1.fmsfsk.sphase &= 0xffffu;
             curbit = s->l1.fmsfsk.dcd_shreg & 1;
-            //verbprintf(9, "%c", '0'+curbit);
-            cir_rxbit(s, curbit);
+            rxbits_put(s, curbit, buffer.fbuffer - start);
         }
     }
     s->l1.fmsfsk.subsamp = length;
+    rxbits_flush(s);
 }
 
 /* ---------------------------------------------------------------------- */
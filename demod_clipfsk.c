@@ -57,6 +57,7 @@ static void clipfsk_init(struct demod_state *s)
 	int i;
 
 	clip_init(s);
+	rxbits_init(s, clip_rxbits, BITDUMP_CLIP);
 	memset(&s->l1.clipfsk, 0, sizeof(s->l1.clipfsk));
 	for (f = 0, i = 0; i < CORRLEN; i++) {
 		corr_mark_i[i] = cos(f);
@@ -74,6 +75,7 @@ static void clipfsk_init(struct demod_state *s)
 
 static void clipfsk_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
 	float f;
 	unsigned char curbit;
 
@@ -108,11 +110,11 @@ static void clipfsk_demod(struct demod_state *s, buffer_t buffer, int length)
 		if (s->l1.clipfsk.sphase >= 0x10000u) {
 			s->l1.clipfsk.sphase &= 0xffffu;
 			curbit = s->l1.clipfsk.dcd_shreg & 1;
-			verbprintf(9, " %c ", '0'+curbit);
-			clip_rxbit(s, curbit);
+			rxbits_put(s, curbit, buffer.fbuffer - start);
 		}
 	}
 	s->l1.clipfsk.subsamp = length;
+	rxbits_flush(s);
 }
 
 /* ---------------------------------------------------------------------- */
@@ -0,0 +1,274 @@
+/*
+ *      demod_ctcss.c -- CTCSS (sub-audible tone squelch) decoder
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include "multimon.h"
+#include "filter.h"
+#include <math.h>
+#include <string.h>
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * The tones all lie between 67 and 254.1 Hz, so the input is low-passed
+ * and decimated by 35 to 630 Hz in two stages: by 7 to 3150 Hz, then by 5
+ * with a filter sharp enough that nothing above 376 Hz (which would alias
+ * onto 254 Hz) gets through. A Goertzel bank over the 50 tones then runs
+ * at 630 Hz, in blocks of 100 ms. Like the DTMF decoder, the blocks are
+ * combined coherently over a sliding window of BLOCKNUM blocks, 500 ms,
+ * which separates even the closest tones (2.3 Hz apart).
+ */
+
+/* DECIM2_TAPS, BLOCKNUM and NTONES must match numbers in multimon.h */
+#define SAMPLE_RATE  22050
+#define DECIM1       7
+#define DECIM1_TAPS  28
+#define DECIM1_CUTOFF 1400
+#define DECIM2       5
+#define DECIM2_TAPS  90
+#define DECIM2_CUTOFF 315
+#define CTCSS_RATE   (SAMPLE_RATE/DECIM1/DECIM2)
+#define BLOCKLEN     (CTCSS_RATE/10)          /* 100 ms blocks */
+#define BLOCKNUM     5
+
+#define NTONES       50
+#define TONE_SHARE   0.25f   /* of the energy left after decimation */
+#define TONE_MARGIN  4.0f    /* over the next strongest tone */
+#define ON_BLOCKS    2       /* consecutive hits before a tone is reported */
+#define OFF_BLOCKS   3       /* consecutive misses before it is gone */
+
+/* tones in 0.1 Hz, the phase increments are rounded to the nearest */
+#define PHINC(x) ((unsigned int)((x)*(double)0x10000/(10*CTCSS_RATE)+0.5))
+
+static const unsigned short ctcss_tone[NTONES] = {
+	670, 693, 719, 744, 770, 797, 825, 854, 885, 915,
+	948, 974, 1000, 1035, 1072, 1109, 1148, 1188, 1230, 1273,
+	1318, 1365, 1413, 1462, 1514, 1567, 1598, 1622, 1655, 1679,
+	1713, 1738, 1773, 1799, 1835, 1862, 1899, 1928, 1966, 1995,
+	2035, 2065, 2107, 2181, 2257, 2291, 2336, 2418, 2503, 2541
+};
+
+/* the Goertzel filters run eight at a time */
+#define LANES        8
+#define NVEC         ((NTONES + LANES - 1) / LANES)
+
+static float decim1_filt[DECIM1_TAPS], decim2_filt[DECIM2_TAPS];
+static unsigned int goertzel_phinc[NTONES];
+static float goertzel_coef[NVEC * LANES], goertzel_cos[NTONES], goertzel_sin[NTONES];
+
+/* ---------------------------------------------------------------------- */
+
+/* Hamming windowed sinc, unity gain at DC */
+static void lowpass(float *filt, unsigned int taps, float cutoff)
+{
+	float sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < taps; i++) {
+		float m = i - (taps - 1) * 0.5f;
+		float x = 2.0f * M_PI * cutoff * m;
+		filt[i] = 0.54f - 0.46f * cosf(2.0f * M_PI * i / (taps - 1));
+		if (x != 0)
+			filt[i] *= sinf(x) / x;
+		sum += filt[i];
+	}
+	for (i = 0; i < taps; i++)
+		filt[i] /= sum;
+}
+
+static void ctcss_init(struct demod_state *s)
+{
+	int i;
+
+	memset(&s->l1.ctcss, 0, sizeof(s->l1.ctcss));
+	s->l1.ctcss.blkcount = BLOCKLEN;
+	s->l1.ctcss.tone = s->l1.ctcss.cand = -1;
+
+	lowpass(decim1_filt, DECIM1_TAPS, (float)DECIM1_CUTOFF / SAMPLE_RATE);
+	lowpass(decim2_filt, DECIM2_TAPS, (float)DECIM2_CUTOFF * DECIM1 / SAMPLE_RATE);
+	for (i = 0; i < NTONES; i++) {
+		goertzel_phinc[i] = PHINC(ctcss_tone[i]);
+		goertzel_cos[i] = cosf(2.0f * M_PI * goertzel_phinc[i] / 0x10000);
+		goertzel_sin[i] = sinf(2.0f * M_PI * goertzel_phinc[i] / 0x10000);
+		goertzel_coef[i] = 2.0f * goertzel_cos[i];
+	}
+}
+
+static void ctcss_deinit(struct demod_state *s)
+{
+	int t = s->l1.ctcss.tone;
+
+	if (t >= 0)
+		verbprintf(0, "CTCSS: %u.%u Hz off\n", ctcss_tone[t] / 10, ctcss_tone[t] % 10);
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * The strongest tone of the window, if it stands out both from the other
+ * tones and from whatever else is left in the band.
+ */
+static int find_tone(struct demod_state *s)
+{
+	float tote = 0, best = 0, second = 0;
+	int i, j, idx = -1;
+
+	for (i = 0; i < BLOCKNUM; i++)
+		tote += s->l1.ctcss.energy[i];
+	for (i = 0; i < NTONES; i++) {
+		float re = 0, im = 0, e;
+		for (j = 0; j < BLOCKNUM; j++) {
+			re += s->l1.ctcss.tenergy[j][i];
+			im += s->l1.ctcss.tenergy[j][i+NTONES];
+		}
+		e = fsqr(re) + fsqr(im);
+		if (e > best) {
+			second = best;
+			best = e;
+			idx = i;
+		} else if (e > second)
+			second = e;
+	}
+	tote *= BLOCKNUM * BLOCKLEN * 0.5f;   /* a pure tone gives best == tote */
+	verbprintf(10, "CTCSS: Energies: %8.5f  best %8.5f (%d)  next %8.5f\n",
+		   tote, best, idx, second);
+	if (idx < 0 || best < tote * TONE_SHARE || best < second * TONE_MARGIN)
+		return -1;
+	return idx;
+}
+
+/*
+ * Turn the Goertzel states into this block's correlations with the tones,
+ * rotated by the phase the tone reference has reached (see demod_dtmf.c),
+ * and report tones coming and going.
+ */
+static void process_block(struct demod_state *s)
+{
+	float *te = s->l1.ctcss.tenergy[s->l1.ctcss.ring];
+	int i, t;
+
+	for (i = 0; i < NTONES; i++) {
+		float yr = s->l1.ctcss.s1[i] - s->l1.ctcss.s2[i] * goertzel_cos[i];
+		float yi = s->l1.ctcss.s2[i] * goertzel_sin[i];
+		unsigned int ph = s->l1.ctcss.ph[i] + goertzel_phinc[i] * (BLOCKLEN - 1);
+		te[i] = yr * COS(ph) + yi * SIN(ph);
+		te[i+NTONES] = yi * COS(ph) - yr * SIN(ph);
+		s->l1.ctcss.ph[i] += goertzel_phinc[i] * BLOCKLEN;
+	}
+	memset(s->l1.ctcss.s1, 0, sizeof(s->l1.ctcss.s1));
+	memset(s->l1.ctcss.s2, 0, sizeof(s->l1.ctcss.s2));
+
+	i = find_tone(s);
+	s->l1.ctcss.ring = (s->l1.ctcss.ring + 1) % BLOCKNUM;
+	s->l1.ctcss.energy[s->l1.ctcss.ring] = 0;
+
+	t = s->l1.ctcss.tone;
+	if (i >= 0 && i == t) {
+		s->l1.ctcss.misses = 0;
+		return;
+	}
+	if (i >= 0 && i == s->l1.ctcss.cand)
+		s->l1.ctcss.hits++;
+	else {
+		s->l1.ctcss.cand = i;
+		s->l1.ctcss.hits = i >= 0;
+	}
+	if (t >= 0 && (++s->l1.ctcss.misses >= OFF_BLOCKS || s->l1.ctcss.hits >= ON_BLOCKS)) {
+		verbprintf(0, "CTCSS: %u.%u Hz off\n", ctcss_tone[t] / 10, ctcss_tone[t] % 10);
+		s->l1.ctcss.tone = t = -1;
+	}
+	if (t < 0 && s->l1.ctcss.hits >= ON_BLOCKS) {
+		verbprintf(0, "CTCSS: %u.%u Hz on\n", ctcss_tone[i] / 10, ctcss_tone[i] % 10);
+		s->l1.ctcss.tone = i;
+		s->l1.ctcss.misses = 0;
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * buffer.fbuffer[k + DECIM1_TAPS - 1] is the newest sample under the first
+ * decimation filter at position k. Its output goes into a delay line kept
+ * twice, so that the last DECIM2_TAPS samples are always contiguous.
+ */
+static void ctcss_demod(struct demod_state *s, buffer_t buffer, int length)
+{
+	const float *in = buffer.fbuffer;
+	float *dl = s->l1.ctcss.delay;
+	int k, i;
+#ifdef HAVE_VECTORS
+	v8sf s1[NVEC], s2[NVEC], coef[NVEC];
+
+	memcpy(s1, s->l1.ctcss.s1, sizeof(s1));
+	memcpy(s2, s->l1.ctcss.s2, sizeof(s2));
+	memcpy(coef, goertzel_coef, sizeof(coef));
+#endif
+
+	for (k = s->l1.ctcss.subsamp; k < length; k += DECIM1) {
+		float x = mac(in + k, decim1_filt, DECIM1_TAPS);
+
+		i = s->l1.ctcss.dlpos;
+		dl[i] = dl[i + DECIM2_TAPS] = x;
+		s->l1.ctcss.dlpos = (i + 1) % DECIM2_TAPS;
+		if (--s->l1.ctcss.decim2 > 0)
+			continue;
+		s->l1.ctcss.decim2 = DECIM2;
+
+		x = mac(dl + i + 1, decim2_filt, DECIM2_TAPS);
+		s->l1.ctcss.energy[s->l1.ctcss.ring] += fsqr(x);
+#ifdef HAVE_VECTORS
+		for (i = 0; i < NVEC; i++) {
+			v8sf s0 = SPLAT8(x) + coef[i] * s1[i] - s2[i];
+			s2[i] = s1[i];
+			s1[i] = s0;
+		}
+#else
+		for (i = 0; i < NTONES; i++) {
+			float s0 = x + goertzel_coef[i] * s->l1.ctcss.s1[i] - s->l1.ctcss.s2[i];
+			s->l1.ctcss.s2[i] = s->l1.ctcss.s1[i];
+			s->l1.ctcss.s1[i] = s0;
+		}
+#endif
+		if (--s->l1.ctcss.blkcount <= 0) {
+			s->l1.ctcss.blkcount = BLOCKLEN;
+#ifdef HAVE_VECTORS
+			memcpy(s->l1.ctcss.s1, s1, sizeof(s1));
+			memcpy(s->l1.ctcss.s2, s2, sizeof(s2));
+#endif
+			process_block(s);
+#ifdef HAVE_VECTORS
+			memset(s1, 0, sizeof(s1));
+			memset(s2, 0, sizeof(s2));
+#endif
+		}
+	}
+	s->l1.ctcss.subsamp = k - length;
+#ifdef HAVE_VECTORS
+	memcpy(s->l1.ctcss.s1, s1, sizeof(s1));
+	memcpy(s->l1.ctcss.s2, s2, sizeof(s2));
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+
+const struct demod_param demod_ctcss = {
+    "CTCSS", true, SAMPLE_RATE, DECIM1_TAPS, ctcss_init, ctcss_demod, ctcss_deinit
+};
+
+/* ---------------------------------------------------------------------- */
@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int dzvei_freq[16] = {
-    PHINC(2200), PHINC(970), PHINC(1060), PHINC(1160),
-    PHINC(1270), PHINC(1400), PHINC(1530), PHINC(1670),
-    PHINC(1830), PHINC(2000), PHINC(825), PHINC(740),
-    PHINC(2600), PHINC(885), PHINC(2400), PHINC(680)
+    2200, 970, 1060, 1160,
+    1270, 1400, 1530, 1670,
+    1830, 2000, 825, 740,
+    2600, 885, 2400, 680
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void dzvei_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, dzvei_freq);
 }
 
 static void dzvei_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void dzvei_deinit(struct demod_state *s)
 
 static void dzvei_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, dzvei_freq, demod_dzvei.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_dzvei.name);
 }
 
 const struct demod_param demod_dzvei = {
-    "DZVEI", true, SAMPLE_RATE, 0, dzvei_init, dzvei_demod, dzvei_deinit
+    "DZVEI", true, SAMPLE_RATE, SELCALL_OVERLAP, dzvei_init, dzvei_demod, dzvei_deinit
 };
 
 
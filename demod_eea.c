@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int eea_freq[16] = {
-    PHINC(1981), PHINC(1124), PHINC(1197), PHINC(1275),
-    PHINC(1358), PHINC(1446), PHINC(1540), PHINC(1640),
-    PHINC(1747), PHINC(1860), PHINC(1055), PHINC(930),
-    PHINC(2400), PHINC(991), PHINC(2110), PHINC(2247)
+    1981, 1124, 1197, 1275,
+    1358, 1446, 1540, 1640,
+    1747, 1860, 1055, 930,
+    2400, 991, 2110, 2247
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void eea_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, eea_freq);
 }
 
 static void eea_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void eea_deinit(struct demod_state *s)
 
 static void eea_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, eea_freq, demod_eea.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_eea.name);
 }
 
 const struct demod_param demod_eea = {
-    "EEA", true, SAMPLE_RATE, 0, eea_init, eea_demod, eea_deinit
+    "EEA", true, SAMPLE_RATE, SELCALL_OVERLAP, eea_init, eea_demod, eea_deinit
 };
 
 
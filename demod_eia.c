@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int eia_freq[16] = {
-    PHINC(600), PHINC(741), PHINC(882), PHINC(1023),
-    PHINC(1164), PHINC(1305), PHINC(1446), PHINC(1587),
-    PHINC(1728), PHINC(1869), PHINC(2151), PHINC(2433),
-    PHINC(2010), PHINC(2292), PHINC(459), PHINC(1091)
+    600, 741, 882, 1023,
+    1164, 1305, 1446, 1587,
+    1728, 1869, 2151, 2433,
+    2010, 2292, 459, 1091
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void eia_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, eia_freq);
 }
 
 static void eia_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void eia_deinit(struct demod_state *s)
 
 static void eia_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, eia_freq, demod_eia.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_eia.name);
 }
 
 const struct demod_param demod_eia = {
-    "EIA", true, SAMPLE_RATE, 0, eia_init, eia_demod, eia_deinit
+    "EIA", true, SAMPLE_RATE, SELCALL_OVERLAP, eia_init, eia_demod, eia_deinit
 };
 
 
@@ -96,12 +96,19 @@
 
 #include "multimon.h"
 #include "filter.h"
+#include "BCH3121.h"
+#ifdef FLEX_BCH_REFERENCE
 #include "BCHCode.h"
+#endif
 #include <math.h>
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef FLEX_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 /* ---------------------------------------------------------------------- */
 
@@ -116,9 +123,18 @@
 #define PHASE_UNLOCKED_RATE  0.050         // Correction factor for unlocked state
 #define LOCK_LEN             24            // Number of symbols to check for phase locking (max 32)
 #define IDLE_THRESHOLD       0             // Number of idle codewords allowed in data section
-#define CAPCODES_INDEX       0
+#define GROUP_CAPCODES_MAX   1000          // Most capcodes remembered for one group message
 #define DEMOD_TIMEOUT        100           // Maximum number of periods with no zero crossings before we decide that the system is not longer within a Timing lock.
 
+// Fixed point versions of the above for the symbol recovery
+#define ZERO_SHIFT           8             // Fraction bits of the DC offset, on top of the 16 bit samples
+#define ZERO_ALPHA           ((int)(65536.0 / (FREQ_SAMP*DC_OFFSET_FILTER + 1) + 0.5))
+#define SLICE_Q16            ((int64_t)(SLICE_THRESHOLD * 65536))
+#define PHASE_LOCKED_Q16     ((int64_t)(PHASE_LOCKED_RATE * 65536))
+#define PHASE_UNLOCKED_Q16   ((int64_t)(PHASE_UNLOCKED_RATE * 65536))
+#define PHASE_MID_LO         0x1999999Au   // 10% of a symbol period
+#define PHASE_MID_HI         0xE6666666u   // 90% of a symbol period
+
 
 enum Flex_PageTypeEnum {
   FLEX_PAGETYPE_SECURE,
@@ -141,13 +157,17 @@ enum Flex_StateEnum {
 
 struct Flex_Demodulator {
   unsigned int                sample_freq;
-  double                      sample_last;
+  int                         sample_last;
   int                         locked;
-  int                         phase;
+  uint32_t                    phase;         // Symbol clock, wraps once per symbol
+  uint32_t                    phase_rate;    // Increment per sample at 'rate_baud'
+  unsigned int                rate_baud;
   unsigned int                sample_count;
   unsigned int                symbol_count;
-  double                      envelope_sum;
+  int32_t                     zero;          // DC offset, ZERO_SHIFT fraction bits
+  int64_t                     envelope_sum;
   int                         envelope_count;
+  int                         slice;         // Level between the inner and outer symbols
   uint64_t                    lock_buf;
   int                         symcount[4];
   int                         timeout;
@@ -156,15 +176,15 @@ struct Flex_Demodulator {
 };
 
 struct Flex_GroupHandler {
-  int64_t                     GroupCodes[17][1000];
+  int64_t *                   GroupCodes[17];     // Capcodes waiting for each group message, grown on demand
+  int                         GroupCount[17];
+  int                         GroupSize[17];
   int                     GroupCycle[17];
   int             GroupFrame[17];
 };
 
 struct Flex_Modulation {
   double                      symbol_rate;
-  double                      envelope;
-  double                      zero;
 };
 
 
@@ -197,6 +217,7 @@ struct Flex_FIW {
 
 struct Flex_Phase {
   unsigned int                buf[88];
+  uint32_t                    fixed[3];      // Words already error corrected
   int                         idle_count;
 };
 
@@ -215,10 +236,14 @@ struct Flex_Decode {
   enum Flex_PageTypeEnum      type;
   int                         long_address;
   int64_t                     capcode;
+#ifdef FLEX_BCH_REFERENCE
   struct BCHCode *            BCHCode;
+#endif
 };
 
 
+struct Flex_Pool;
+
 struct Flex {
   struct Flex_Demodulator     Demodulator;
   struct Flex_Modulation      Modulation;
@@ -228,6 +253,7 @@ struct Flex {
   struct Flex_Data            Data;
   struct Flex_Decode          Decode;
         struct Flex_GroupHandler    GroupHandler;
+  struct Flex_Pool *          Pool;          // Frames are decoded on worker threads if set
 };
 
 
@@ -269,43 +295,63 @@ unsigned int count_bits(struct Flex * flex, unsigned int data) {
 #endif
 }
 
-static int bch3121_fix_errors(struct Flex * flex, uint32_t * data_to_fix, char PhaseNo) {
-  if (flex==NULL) return -1;
+#ifdef FLEX_BCH_REFERENCE
+/*
+ * Cross-check the table decoder against the generic BCHCode decoder. The
+ * latter accepts some words with three or more errors as they are (S1 = 0,
+ * S3 != 0), those are not reported.
+ */
+static struct BCHCode * bch3121_reference(void) {
+  /*Generator polynomial for BCH3121 Code*/
+  int p[6];
+  p[0] = p[2] = p[5] = 1; p[1] = p[3] = p[4] =0;
+  return BCHCode_New( p, 5, 31, 21, 2);
+}
+
+static void bch3121_check(struct Flex * flex, uint32_t word, uint32_t fixed, int fix_result) {
   int i=0;
   int recd[31];
-
-  /*Convert the data pattern into an array of coefficients*/
-  unsigned int data=*data_to_fix;
+  uint32_t data=word;
   for (i=0; i<31; i++) {
     recd[i] = (data>>30)&1;
     data<<=1;
   }
+  int ref_error=BCHCode_Decode(flex->Decode.BCHCode, recd);
+  data=0;
+  for (i=0; i<31; i++) {
+    data<<=1;
+    data|=recd[i];
+  }
+  if (fix_result<0 && (ref_error || data==(word&0x7FFFFFFF)))
+    return;
+  if (ref_error || fix_result<0 || data!=fixed)
+    fprintf(stderr, "FLEX: BCH mismatch @ 0x%08x: reference %s 0x%08x, table %s 0x%08x\n", word,
+            ref_error ? "failed" : "ok", data, fix_result<0 ? "failed" : "ok", fixed);
+}
+#endif
 
-  /*Decode and correct the coefficients*/
-  int decode_error=BCHCode_Decode(flex->Decode.BCHCode, recd);
+static int bch3121_fix_errors(struct Flex * flex, uint32_t * data_to_fix, char PhaseNo) {
+  if (flex==NULL) return -1;
+
+  uint32_t data=*data_to_fix;
+  int fixed=bch3121_correct(&data);
+#ifdef FLEX_BCH_REFERENCE
+  bch3121_check(flex, *data_to_fix, data, fixed);
+#endif
 
   /*Decode successful?*/
-  if (!decode_error) {
-    /*Convert the coefficient array back to a bit pattern*/
-    data=0;
-    for (i=0; i<31; i++) {
-      data<<=1;
-      data|=recd[i];
-    }
-    /*Count the number of fixed errors*/
-    int fixed=count_bits(flex, (*data_to_fix & 0x7FFFFFFF) ^ data);
+  if (fixed>=0) {
     if (fixed>0) {
       verbprintf(3, "FLEX: Phase %c Fixed %i errors @ 0x%08x  (0x%08x -> 0x%08x)\n", PhaseNo, fixed, (*data_to_fix&0x7FFFFFFF) ^ data, (*data_to_fix&0x7FFFFFFF), data );
     }
 
     /*Write the fixed data back to the caller*/
     *data_to_fix=data;
-
-  } else {
-    verbprintf(3, "FLEX: Phase %c Data corruption - Unable to fix errors.\n", PhaseNo);
+    return 0;
   }
 
-  return decode_error;
+  verbprintf(3, "FLEX: Phase %c Data corruption - Unable to fix errors.\n", PhaseNo);
+  return 1;
 }
 
 static unsigned int flex_sync_check(struct Flex * flex, uint64_t buf) {
@@ -397,6 +443,131 @@ static void read_2fsk(struct Flex * flex, unsigned int sym, unsigned int * dat)
 }
 
 
+/*
+ * Remember a capcode that is to receive the next message for its group.
+ * Each group's list grows with its membership, most stay empty.
+ */
+static int group_add(struct Flex * flex, int groupbit, int64_t capcode) {
+  struct Flex_GroupHandler * gh = &flex->GroupHandler;
+
+  if ((unsigned int)groupbit >= 17) {
+    verbprintf(1, "FLEX: Group bit %i out of range, dropping Capcode: [%09lld]\n", groupbit, capcode);
+    return -1;
+  }
+  if (gh->GroupCount[groupbit] >= GROUP_CAPCODES_MAX) {
+    verbprintf(1, "FLEX: Group bit %i has too many capcodes, dropping Capcode: [%09lld]\n", groupbit, capcode);
+    return -1;
+  }
+  if (gh->GroupCount[groupbit] == gh->GroupSize[groupbit]) {
+    int size = gh->GroupSize[groupbit] ? 2 * gh->GroupSize[groupbit] : 8;
+    int64_t * codes = realloc(gh->GroupCodes[groupbit], size * sizeof(*codes));
+    if (codes == NULL) {
+      verbprintf(0, "FLEX: Out of memory for group capcodes\n");
+      return -1;
+    }
+    gh->GroupCodes[groupbit] = codes;
+    gh->GroupSize[groupbit] = size;
+  }
+  gh->GroupCodes[groupbit][gh->GroupCount[groupbit]++] = capcode;
+  return 0;
+}
+
+static size_t group_memory(struct Flex * flex) {
+  size_t bytes = 0;
+  int g;
+
+  for (g = 0; g < 17; g++)
+    bytes += flex->GroupHandler.GroupSize[g] * sizeof(int64_t);
+  return bytes;
+}
+
+static void group_free(struct Flex * flex) {
+  int g;
+
+  for (g = 0; g < 17; g++)
+    free(flex->GroupHandler.GroupCodes[g]);
+}
+
+/*
+ * If the expected frame of a pending group message has gone by, the
+ * message was missed: report and forget its capcodes.
+ */
+static void check_group_frames(struct Flex * flex) {
+  // Lets check the FrameNo against the expected group message frames, if we have 'Missed a group message' tell the user and clear the Cap Codes
+              for(int g = 0; g < 17 ;g++)
+              {
+    // Do we have a group message pending for this groupbit?
+    if(flex->GroupHandler.GroupFrame[g] >= 0)
+    {
+      int Reset = 0;
+      verbprintf(4, "Flex: GroupBit %i, FrameNo: %i, Cycle No: %i target Cycle No: %i\n", g, flex->GroupHandler.GroupFrame[g], flex->GroupHandler.GroupCycle[g], (int)flex->FIW.cycleno); 
+      // Now lets check if its expected in this frame..
+      if((int)flex->FIW.cycleno == flex->GroupHandler.GroupCycle[g])
+      {
+        if(flex->GroupHandler.GroupFrame[g] < (int)flex->FIW.frameno)
+        {
+          Reset = 1;
+        }
+      }
+                              // Check if we should have sent a group message in the previous cycle 
+      else if(flex->FIW.cycleno == 0) 
+      {
+        if(flex->GroupHandler.GroupCycle[g] == 15)
+        {
+          Reset = 1;
+        }
+      }
+                              // If we are waiting for the cycle to roll over then move onto the next for loop item 
+      else if(flex->FIW.cycleno == 15 && flex->GroupHandler.GroupCycle[g] == 0)
+      {
+        continue;
+      } 
+      // Otherwise if the target cycle is less than the current cycle, reset the data
+      else if(flex->GroupHandler.GroupCycle[g] < (int)flex->FIW.cycleno)
+      {
+        Reset = 1;
+      }
+    
+
+      if(Reset == 1)
+      {
+                            
+                    int endpoint = flex->GroupHandler.GroupCount[g];
+        if(REPORT_GROUP_CODES > 0)
+        {
+          verbprintf(3,"FLEX: Group messages seem to have been missed; Groupbit: %i; Total Capcodes: %i; Clearing Data; Capcodes: ", g, endpoint);
+        }
+        
+                    for(int capIndex = 1; capIndex <= endpoint; capIndex++)
+        {
+          if(REPORT_GROUP_CODES == 0)
+          {
+            verbprintf(3,"FLEX: Group messages seem to have been missed; Groupbit: %i; Clearing data; Capcode: [%09lld]\n", g, flex->GroupHandler.GroupCodes[g][capIndex-1]);
+          }
+          else
+          {
+            if(capIndex > 1)
+            {
+              verbprintf(3,",");
+            }
+            verbprintf(3,"[%09lld]", flex->GroupHandler.GroupCodes[g][capIndex-1]);
+          }
+        }
+
+        if(REPORT_GROUP_CODES > 0)
+                                      {
+                                              verbprintf(3,"\n");
+                                      }
+
+                    // reset the value
+                    flex->GroupHandler.GroupCount[g] = 0;
+                    flex->GroupHandler.GroupFrame[g] = -1;
+                    flex->GroupHandler.GroupCycle[g] = -1;
+      }
+    }
+              }
+}
+
 static int decode_fiw(struct Flex * flex) {
   if (flex==NULL) return -1;
   unsigned int fiw = flex->FIW.rawdata;
@@ -431,79 +602,9 @@ static int decode_fiw(struct Flex * flex) {
         flex->FIW.fix3,
         timeseconds/60,
         timeseconds%60);
-    // Lets check the FrameNo against the expected group message frames, if we have 'Missed a group message' tell the user and clear the Cap Codes
-                for(int g = 0; g < 17 ;g++)
-                {
-      // Do we have a group message pending for this groupbit?
-      if(flex->GroupHandler.GroupFrame[g] >= 0)
-      {
-        int Reset = 0;
-        verbprintf(4, "Flex: GroupBit %i, FrameNo: %i, Cycle No: %i target Cycle No: %i\n", g, flex->GroupHandler.GroupFrame[g], flex->GroupHandler.GroupCycle[g], (int)flex->FIW.cycleno); 
-        // Now lets check if its expected in this frame..
-        if((int)flex->FIW.cycleno == flex->GroupHandler.GroupCycle[g])
-        {
-          if(flex->GroupHandler.GroupFrame[g] < (int)flex->FIW.frameno)
-          {
-            Reset = 1;
-          }
-        }
-                                // Check if we should have sent a group message in the previous cycle 
-        else if(flex->FIW.cycleno == 0) 
-        {
-          if(flex->GroupHandler.GroupCycle[g] == 15)
-          {
-            Reset = 1;
-          }
-        }
-                                // If we are waiting for the cycle to roll over then move onto the next for loop item 
-        else if(flex->FIW.cycleno == 15 && flex->GroupHandler.GroupCycle[g] == 0)
-        {
-          continue;
-        } 
-        // Otherwise if the target cycle is less than the current cycle, reset the data
-        else if(flex->GroupHandler.GroupCycle[g] < (int)flex->FIW.cycleno)
-        {
-          Reset = 1;
-        }
-      
-
-        if(Reset == 1)
-        {
-                              
-                      int endpoint = flex->GroupHandler.GroupCodes[g][CAPCODES_INDEX];
-          if(REPORT_GROUP_CODES > 0)
-          {
-            verbprintf(3,"FLEX: Group messages seem to have been missed; Groupbit: %i; Total Capcodes: %i; Clearing Data; Capcodes: ", g, endpoint);
-          }
-          
-                      for(int capIndex = 1; capIndex <= endpoint; capIndex++)
-          {
-            if(REPORT_GROUP_CODES == 0)
-            {
-              verbprintf(3,"FLEX: Group messages seem to have been missed; Groupbit: %i; Clearing data; Capcode: [%09lld]\n", g, flex->GroupHandler.GroupCodes[g][capIndex]);
-            }
-            else
-            {
-              if(capIndex > 1)
-              {
-                verbprintf(3,",");
-              }
-              verbprintf(3,"[%09lld]", flex->GroupHandler.GroupCodes[g][capIndex]);
-            }
-          }
-
-          if(REPORT_GROUP_CODES > 0)
-                                        {
-                                                verbprintf(3,"\n");
-                                        }
-
-                      // reset the value
-                      flex->GroupHandler.GroupCodes[g][CAPCODES_INDEX] = 0;
-                      flex->GroupHandler.GroupFrame[g] = -1;
-                      flex->GroupHandler.GroupCycle[g] = -1;
-        }
-      }
-                }
+    // The pool checks this when it decodes the frame, it owns the group state then
+    if (flex->Pool == NULL)
+      check_group_frames(flex);
     return 0;
   } else {
     verbprintf(3, "FLEX: Bad Checksum 0x%x\n", checksum);
@@ -518,7 +619,7 @@ static void parse_alphanumeric(struct Flex * flex, unsigned int * phaseptr, char
 
         int i;
         time_t now=time(NULL);
-        struct tm * gmt=gmtime(&now);
+        struct tm tm_buf, * gmt=gmtime_r(&now, &tm_buf);
         // char buf[1024], *message;
         char message[1024];
         int  currentChar = 0; 
@@ -569,20 +670,20 @@ static void parse_alphanumeric(struct Flex * flex, unsigned int * phaseptr, char
 
         if(flex_groupmessage == 1) {
                 int groupbit = flex->Decode.capcode-2029568;
-                if(groupbit < 0) return;
+                if(groupbit < 0 || groupbit >= 17) return;
 
-                int endpoint = flex->GroupHandler.GroupCodes[groupbit][CAPCODES_INDEX];
+                int endpoint = flex->GroupHandler.GroupCount[groupbit];
                 for(int g = 1; g <= endpoint;g++)
                 {
-                        verbprintf(1, "FLEX Group message output: Groupbit: %i Total Capcodes; %i; index %i; Capcode: [%09lld]\n", groupbit, endpoint, g, flex->GroupHandler.GroupCodes[groupbit][g]);
+                        verbprintf(1, "FLEX Group message output: Groupbit: %i Total Capcodes; %i; index %i; Capcode: [%09lld]\n", groupbit, endpoint, g, flex->GroupHandler.GroupCodes[groupbit][g-1]);
 
                         verbprintf(0,  "FLEX: %04i-%02i-%02i %02i:%02i:%02i %i/%i/%c/%c %02i.%03i [%09lld] ALN ", gmt->tm_year+1900, gmt->tm_mon+1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
-                                        flex->Sync.baud, flex->Sync.levels, frag_flag, PhaseNo, flex->FIW.cycleno, flex->FIW.frameno, flex->GroupHandler.GroupCodes[groupbit][g]);
+                                        flex->Sync.baud, flex->Sync.levels, frag_flag, PhaseNo, flex->FIW.cycleno, flex->FIW.frameno, flex->GroupHandler.GroupCodes[groupbit][g-1]);
 
                         verbprintf(0, "%s\n", message);
                 }
                 // reset the value
-                flex->GroupHandler.GroupCodes[groupbit][CAPCODES_INDEX] = 0;
+                flex->GroupHandler.GroupCount[groupbit] = 0;
     flex->GroupHandler.GroupFrame[groupbit] = -1;
     flex->GroupHandler.GroupCycle[groupbit] = -1;
         }
@@ -596,17 +697,17 @@ static void parse_alphanumeric(struct Flex * flex, unsigned int * phaseptr, char
 
         if(flex_groupmessage == 1) {
                 int groupbit = flex->Decode.capcode-2029568;
-                if(groupbit < 0) return;
+                if(groupbit < 0 || groupbit >= 17) return;
 
-                int endpoint = flex->GroupHandler.GroupCodes[groupbit][CAPCODES_INDEX];
+                int endpoint = flex->GroupHandler.GroupCount[groupbit];
                 for(int g = 1; g <= endpoint;g++)
                 {
-                        verbprintf(1, "FLEX Group message output: Groupbit: %i Total Capcodes; %i; index %i; Capcode: [%09lld]\n", groupbit, endpoint, g, flex->GroupHandler.GroupCodes[groupbit][g]);
-                        pt_offset += sprintf(pt_out + pt_offset, " %09lld", flex->GroupHandler.GroupCodes[groupbit][g]);
+                        verbprintf(1, "FLEX Group message output: Groupbit: %i Total Capcodes; %i; index %i; Capcode: [%09lld]\n", groupbit, endpoint, g, flex->GroupHandler.GroupCodes[groupbit][g-1]);
+                        pt_offset += sprintf(pt_out + pt_offset, " %09lld", flex->GroupHandler.GroupCodes[groupbit][g-1]);
                 }
 
                 // reset the value
-                flex->GroupHandler.GroupCodes[groupbit][CAPCODES_INDEX] = 0;
+                flex->GroupHandler.GroupCount[groupbit] = 0;
                 flex->GroupHandler.GroupFrame[groupbit] = -1;
                 flex->GroupHandler.GroupCycle[groupbit] = -1;
         } 
@@ -624,7 +725,7 @@ static void parse_numeric(struct Flex * flex, unsigned int * phaseptr, char Phas
   w2 = (w2 & 0x07) + w1;  // numeric message is 7 words max
 
   time_t now=time(NULL);
-  struct tm * gmt=gmtime(&now);
+  struct tm tm_buf, * gmt=gmtime_r(&now, &tm_buf);
   verbprintf(0,  "FLEX: %04i-%02i-%02i %02i:%02i:%02i %i/%i/%c %02i.%03i [%09lld] NUM ", gmt->tm_year+1900, gmt->tm_mon+1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
       flex->Sync.baud, flex->Sync.levels, PhaseNo, flex->FIW.cycleno, flex->FIW.frameno, flex->Decode.capcode);
 
@@ -673,7 +774,7 @@ static void parse_numeric(struct Flex * flex, unsigned int * phaseptr, char Phas
 //static void parse_tone_only(struct Flex * flex, char PhaseNo) {
 //  if (flex==NULL) return;
 //  time_t now=time(NULL);
-//  struct tm * gmt=gmtime(&now);
+//  struct tm tm_buf, * gmt=gmtime_r(&now, &tm_buf);
 //  verbprintf(0,  "FLEX: %04i-%02i-%02i %02i:%02i:%02i %i/%i/%c %02i.%03i [%09lld] TON\n", gmt->tm_year+1900, gmt->tm_mon+1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
 //      flex->Sync.baud, flex->Sync.levels, PhaseNo, flex->FIW.cycleno, flex->FIW.frameno, flex->Decode.capcode);
 //}
@@ -683,7 +784,7 @@ static void parse_tone_only(struct Flex * flex, unsigned int * phaseptr, char Ph
   unsigned const char flex_bcd[17] = "0123456789 U -][";
   
   time_t now=time(NULL);
-  struct tm * gmt=gmtime(&now);
+  struct tm tm_buf, * gmt=gmtime_r(&now, &tm_buf);
   verbprintf(0,  "FLEX: %04i-%02i-%02i %02i:%02i:%02i %i/%i/%c %02i.%03i [%09lld] TON ", gmt->tm_year+1900, gmt->tm_mon+1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec, flex->Sync.baud, flex->Sync.levels, PhaseNo, flex->FIW.cycleno, flex->FIW.frameno, flex->Decode.capcode);
 
   // message type
@@ -714,7 +815,7 @@ static void parse_tone_only(struct Flex * flex, unsigned int * phaseptr, char Ph
 static void parse_unknown(struct Flex * flex, unsigned int * phaseptr, char PhaseNo, int mw1, int mw2) {
   if (flex==NULL) return;
   time_t now=time(NULL);
-  struct tm * gmt=gmtime(&now);
+  struct tm tm_buf, * gmt=gmtime_r(&now, &tm_buf);
   verbprintf(0,  "FLEX: %04i-%02i-%02i %02i:%02i:%02i %i/%i/%c %02i.%03i [%09lld] UNK", gmt->tm_year+1900, gmt->tm_mon+1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec,
       flex->Sync.baud, flex->Sync.levels, PhaseNo, flex->FIW.cycleno, flex->FIW.frameno, flex->Decode.capcode);
 
@@ -741,35 +842,53 @@ static void parse_capcode(struct Flex * flex, uint32_t aw1) {
 }
 
 
-static void decode_phase(struct Flex * flex, char PhaseNo) {
-  if (flex==NULL) return;
-
-  uint32_t *phaseptr=NULL;
-  int i, j;
+/*
+ * Error correct words first..last of a phase, skipping those already done,
+ * and strip them down to their 21 message bits. Returns non-zero if one of
+ * them is beyond repair.
+ */
+static int fix_words(struct Flex * flex, uint32_t * phaseptr, uint32_t * done, int first, int last, char PhaseNo) {
+  int i;
 
-  switch (PhaseNo) {
-    case 'A': phaseptr=flex->Data.PhaseA.buf; break;
-    case 'B': phaseptr=flex->Data.PhaseB.buf; break;
-    case 'C': phaseptr=flex->Data.PhaseC.buf; break;
-    case 'D': phaseptr=flex->Data.PhaseD.buf; break;
-  }
+  if (first < 0) first = 0;
+  if (last > 87) last = 87;
 
-  for (i=0; i<88; i++) {
-    int decode_error=bch3121_fix_errors(flex, &phaseptr[i], PhaseNo);
+  for (i=first; i<=last; i++) {
+    if (done[i >> 5] & (1u << (i & 31)))
+      continue;
 
-    if (decode_error) {
+    if (bch3121_fix_errors(flex, &phaseptr[i], PhaseNo)) {
       verbprintf(3, "FLEX: Garbled message at block %i\n", i);
-
-                        // If the previous frame was a short message then we need to Null out the Group Message pointer
-                        // this issue and sugested resolution was presented by 'bertinholland'
-
-
-      return;
+      return -1;
     }
 
     /*Extract just the message bits*/
     phaseptr[i]&=0x001FFFFF;
+    done[i >> 5] |= 1u << (i & 31);
+  }
+  return 0;
+}
+
+static void decode_phase(struct Flex * flex, char PhaseNo) {
+  if (flex==NULL) return;
+
+  struct Flex_Phase *phase=NULL;
+  int i, j;
+
+  switch (PhaseNo) {
+    case 'A': phase=&flex->Data.PhaseA; break;
+    case 'B': phase=&flex->Data.PhaseB; break;
+    case 'C': phase=&flex->Data.PhaseC; break;
+    case 'D': phase=&flex->Data.PhaseD; break;
   }
+  uint32_t *phaseptr=phase->buf;
+
+  // Words are only error corrected once something refers to them, most
+  // frames carry few pages and the idle words after them are never read
+  uint32_t *done=phase->fixed;
+
+  if (fix_words(flex, phaseptr, done, 0, 0, PhaseNo))
+    return;
 
   // Block information word is the first data word in frame
   uint32_t biw = phaseptr[0];
@@ -793,6 +912,9 @@ static void decode_phase(struct Flex * flex, char PhaseNo) {
   for (i = aoffset; i < voffset; i++) {
     j = voffset+i-aoffset;    // Start of vector field for address @ i
 
+    if (fix_words(flex, phaseptr, done, i, i, PhaseNo))
+      return;
+
     if (phaseptr[i] == 0x00000000 ||
         phaseptr[i] == 0x001FFFFF) {
       verbprintf(3, "FLEX: Idle codewords, invalid address\n");
@@ -819,6 +941,8 @@ static void decode_phase(struct Flex * flex, char PhaseNo) {
     verbprintf(3, "FLEX: CAPCODE:%016lx\n", flex->Decode.capcode);
 
     // Parse vector information word for address @ offset 'i'
+    if (fix_words(flex, phaseptr, done, j, flex->Decode.long_address ? j+1 : j, PhaseNo))
+      return;
     uint32_t viw = phaseptr[j];
     flex->Decode.type = ((viw >> 4) & 0x00000007);
     int mw1 = (viw >> 7) & 0x00000007F;
@@ -838,11 +962,11 @@ static void decode_phase(struct Flex * flex, char PhaseNo) {
                     
         ////////#############################################################################                 
         ////////#############################################################################                 
-                    flex->GroupHandler.GroupCodes[groupbit][CAPCODES_INDEX]++;
-                    int CapcodePlacement = flex->GroupHandler.GroupCodes[groupbit][CAPCODES_INDEX];
+                    if (group_add(flex, groupbit, flex->Decode.capcode) < 0)
+                      continue;
+                    int CapcodePlacement = flex->GroupHandler.GroupCount[groupbit];
                     verbprintf(1, "FLEX: Found Short Instruction, Group bit: %i capcodes in group so far %i, adding Capcode: [%09lld]\n", groupbit, CapcodePlacement, flex->Decode.capcode);
 
-                    flex->GroupHandler.GroupCodes[groupbit][CapcodePlacement] = flex->Decode.capcode;
                     flex->GroupHandler.GroupFrame[groupbit] = iAssignedFrame;
 
         // Ok, so the cycle and frame can be used to make sure we haven't missed the message frame.
@@ -880,6 +1004,12 @@ static void decode_phase(struct Flex * flex, char PhaseNo) {
 
     if (is_tone_page(flex))
       mw1 = mw2 = 0;
+    else if (is_numeric_page(flex)) {
+      // parse_numeric() reads one word past the end of its message
+      if (fix_words(flex, phaseptr, done, mw1, mw1 + ((viw >> 14) & 0x07) + 1, PhaseNo))
+        return;
+    } else if (fix_words(flex, phaseptr, done, mw1, mw2, PhaseNo))
+      return;
 
 
                 // Check if this is an alpha message
@@ -909,6 +1039,10 @@ static void clear_phase_data(struct Flex * flex) {
     flex->Data.PhaseC.buf[i]=0;
     flex->Data.PhaseD.buf[i]=0;
   }
+  memset(flex->Data.PhaseA.fixed, 0, sizeof(flex->Data.PhaseA.fixed));
+  memset(flex->Data.PhaseB.fixed, 0, sizeof(flex->Data.PhaseB.fixed));
+  memset(flex->Data.PhaseC.fixed, 0, sizeof(flex->Data.PhaseC.fixed));
+  memset(flex->Data.PhaseD.fixed, 0, sizeof(flex->Data.PhaseD.fixed));
 
   flex->Data.PhaseA.idle_count=0;
   flex->Data.PhaseB.idle_count=0;
@@ -945,6 +1079,284 @@ static void decode_data(struct Flex * flex) {
 }
 
 
+/* ---------------------------------------------------------------------- */
+
+unsigned int flex_threads = 0;           // --flex-threads
+
+#ifdef FLEX_THREADS
+/*
+ * Frame decoding off the demodulator thread. At the end of a data section
+ * the demodulator copies the phases into the next free job slot and moves
+ * on, a full ring drops the frame rather than holding up the samples. Each
+ * job then passes through three stages, handed over by its atomic state:
+ *
+ *  - any worker error corrects every word of its phases (JOB_FIXING),
+ *  - the worker holding the 'parsing' token decodes finished jobs strictly
+ *    in frame order, since group messages link frames; its output is
+ *    captured in the job (JOB_FIXED -> JOB_PARSED),
+ *  - the demodulator thread prints parsed jobs in order and frees them.
+ *
+ * The mutex and condition are only there for idle workers to sleep on.
+ */
+#define FLEX_JOBS            16
+
+enum { JOB_FREE, JOB_QUEUED, JOB_FIXING, JOB_FIXED, JOB_PARSED };
+
+struct Flex_Job {
+  int                         state;
+  unsigned int                seq;
+  struct Flex_Sync            Sync;
+  struct Flex_FIW             FIW;
+  struct Flex_Data            Data;
+  struct verb_buffer          out;
+};
+
+struct Flex_Pool {
+  struct Flex *               decoder;       // Decode and group state of the in order stage
+  struct Flex_Job             job[FLEX_JOBS];
+  unsigned int                next_queue;    // Demodulator thread only
+  unsigned int                next_print;    // Demodulator thread only
+  unsigned int                next_parse;    // Holder of 'parsing' only
+  int                         parsing;
+  int                         stop;
+  unsigned int                dropped;
+  unsigned int                nthreads;
+  pthread_t *                 thread;
+  pthread_mutex_t             lock;
+  pthread_cond_t              wake;
+};
+
+#define job_state(j)         __atomic_load_n(&(j)->state, __ATOMIC_ACQUIRE)
+#define set_job_state(j, v)  __atomic_store_n(&(j)->state, (v), __ATOMIC_RELEASE)
+
+static void fix_phase(struct Flex_Phase * phase) {
+  int i;
+
+  for (i=0; i<88; i++) {
+    uint32_t word=phase->buf[i];
+    // Words beyond repair are left for decode_phase() to report
+    if (bch3121_correct(&word) >= 0) {
+      phase->buf[i]=word & 0x001FFFFF;
+      phase->fixed[i >> 5] |= 1u << (i & 31);
+    }
+  }
+}
+
+static void fix_job(struct Flex_Job * job) {
+  fix_phase(&job->Data.PhaseA);
+  if (job->Sync.levels==4)
+    fix_phase(&job->Data.PhaseB);
+  if (job->Sync.baud==3200) {
+    fix_phase(&job->Data.PhaseC);
+    if (job->Sync.levels==4)
+      fix_phase(&job->Data.PhaseD);
+  }
+}
+
+static void parse_jobs(struct Flex_Pool * pool) {
+  struct Flex * decoder = pool->decoder;
+  struct Flex_Job * job;
+  int idle;
+
+  for (;;) {
+    idle = 0;
+    if (!__atomic_compare_exchange_n(&pool->parsing, &idle, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      return;
+
+    for (;;) {
+      job = &pool->job[pool->next_parse % FLEX_JOBS];
+      if (job_state(job) != JOB_FIXED || job->seq != pool->next_parse)
+        break;
+
+      decoder->Sync = job->Sync;
+      decoder->FIW = job->FIW;
+      decoder->Data = job->Data;
+      verb_capture(&job->out);
+      check_group_frames(decoder);
+      decode_data(decoder);
+      verb_capture(NULL);
+
+      set_job_state(job, JOB_PARSED);
+      __atomic_store_n(&pool->next_parse, pool->next_parse + 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&pool->parsing, 0, __ATOMIC_RELEASE);
+
+    // The next job may have been fixed after we looked and before we let go
+    unsigned int next = __atomic_load_n(&pool->next_parse, __ATOMIC_ACQUIRE);
+    job = &pool->job[next % FLEX_JOBS];
+    if (job_state(job) != JOB_FIXED || job->seq != next)
+      return;
+  }
+}
+
+static struct Flex_Job * claim_job(struct Flex_Pool * pool) {
+  int i;
+
+  for (i=0; i<FLEX_JOBS; i++) {
+    int queued = JOB_QUEUED;
+    if (__atomic_compare_exchange_n(&pool->job[i].state, &queued, JOB_FIXING, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      return &pool->job[i];
+  }
+  return NULL;
+}
+
+static void * flex_worker(void * arg) {
+  struct Flex_Pool * pool = arg;
+  struct Flex_Job * job;
+
+  for (;;) {
+    if ((job = claim_job(pool)) != NULL) {
+      fix_job(job);
+      set_job_state(job, JOB_FIXED);
+      parse_jobs(pool);
+      continue;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop && (job = claim_job(pool)) == NULL)
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    if (job == NULL)
+      return NULL;
+    fix_job(job);
+    set_job_state(job, JOB_FIXED);
+    parse_jobs(pool);
+  }
+}
+
+static void queue_frame(struct Flex * flex) {
+  struct Flex_Pool * pool = flex->Pool;
+  struct Flex_Job * job = &pool->job[pool->next_queue % FLEX_JOBS];
+
+  if (job_state(job) != JOB_FREE) {
+    pool->dropped++;
+    verbprintf(1, "FLEX: Decoders busy, frame %02i.%03i dropped\n", flex->FIW.cycleno, flex->FIW.frameno);
+    return;
+  }
+  job->seq = pool->next_queue++;
+  job->Sync = flex->Sync;
+  job->FIW = flex->FIW;
+  job->Data = flex->Data;
+  set_job_state(job, JOB_QUEUED);
+
+  pthread_mutex_lock(&pool->lock);
+  pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void print_frames(struct Flex_Pool * pool) {
+  struct Flex_Job * job;
+
+  while (pool->next_print != pool->next_queue) {
+    job = &pool->job[pool->next_print % FLEX_JOBS];
+    if (job_state(job) != JOB_PARSED)
+      break;
+    verb_release(&job->out);
+    set_job_state(job, JOB_FREE);
+    pool->next_print++;
+  }
+}
+
+static struct Flex_Pool * pool_new(unsigned int nthreads) {
+  struct Flex_Pool * pool = calloc(1, sizeof(struct Flex_Pool));
+  unsigned int i;
+
+  if (pool == NULL)
+    return NULL;
+  pool->decoder = calloc(1, sizeof(struct Flex));
+  pool->thread = calloc(nthreads, sizeof(pthread_t));
+  if (pool->decoder == NULL || pool->thread == NULL) {
+    free(pool->decoder);
+    free(pool->thread);
+    free(pool);
+    return NULL;
+  }
+#ifdef FLEX_BCH_REFERENCE
+  // decode_data() cross-checks the words the workers could not fix
+  pool->decoder->Decode.BCHCode = bch3121_reference();
+  if (pool->decoder->Decode.BCHCode == NULL) {
+    free(pool->decoder);
+    free(pool->thread);
+    free(pool);
+    return NULL;
+  }
+#endif
+  for (i=0; i<17; i++) {
+    pool->decoder->GroupHandler.GroupFrame[i] = -1;
+    pool->decoder->GroupHandler.GroupCycle[i] = -1;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  for (i=0; i<nthreads; i++) {
+    if (pthread_create(&pool->thread[i], NULL, flex_worker, pool))
+      break;
+    pool->nthreads++;
+  }
+  if (pool->nthreads == 0) {
+    verbprintf(0, "FLEX: Unable to start worker threads, decoding in line\n");
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+#ifdef FLEX_BCH_REFERENCE
+    BCHCode_Delete(pool->decoder->Decode.BCHCode);
+#endif
+    free(pool->decoder);
+    free(pool->thread);
+    free(pool);
+    return NULL;
+  }
+  verbprintf(2, "FLEX: Decoding frames on %u worker threads\n", pool->nthreads);
+  return pool;
+}
+
+/*
+ * Waits for the frames in flight, prints them and stops the workers.
+ * Adds the memory the pool held to *bytes and *group_bytes.
+ */
+static void pool_delete(struct Flex_Pool * pool, size_t * bytes, size_t * group_bytes) {
+  unsigned int i;
+
+  while (pool->next_print != pool->next_queue) {
+    print_frames(pool);
+    if (pool->next_print != pool->next_queue)
+      usleep(1000);
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (i=0; i<pool->nthreads; i++)
+    pthread_join(pool->thread[i], NULL);
+
+  if (pool->dropped)
+    verbprintf(1, "FLEX: %u frames dropped, the decoders could not keep up\n", pool->dropped);
+  *bytes += sizeof(struct Flex_Pool) + sizeof(struct Flex) + pool->nthreads * sizeof(pthread_t);
+  *group_bytes += group_memory(pool->decoder);
+  for (i=0; i<FLEX_JOBS; i++) {
+    *bytes += pool->job[i].out.size;
+    free(pool->job[i].out.buf);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  group_free(pool->decoder);
+#ifdef FLEX_BCH_REFERENCE
+  BCHCode_Delete(pool->decoder->Decode.BCHCode);
+#endif
+  free(pool->decoder);
+  free(pool->thread);
+  free(pool);
+}
+#endif
+
+/* A completed data section: decode it here or hand it to the pool */
+static void flex_frame_done(struct Flex * flex) {
+#ifdef FLEX_THREADS
+  if (flex->Pool != NULL) {
+    queue_frame(flex);
+    return;
+  }
+#endif
+  decode_data(flex);
+}
+
 static int read_data(struct Flex * flex, unsigned char sym) {
   if (flex==NULL) return -1;
   // Here is where we output a 1 or 0 on each phase according
@@ -1086,7 +1498,9 @@ static void flex_sym(struct Flex * flex, unsigned char sym) {
             flex->State.Current=FLEX_STATE_FIW;
 
             verbprintf(2, "FLEX: SyncInfoWord: sync_code=0x%04x baud=%i levels=%i polarity=%s zero=%f envelope=%f symrate=%f\n",
-                sync_code, flex->Sync.baud, flex->Sync.levels, flex->Sync.polarity?"NEG":"POS", flex->Modulation.zero, flex->Modulation.envelope, flex->Modulation.symbol_rate);
+                sync_code, flex->Sync.baud, flex->Sync.levels, flex->Sync.polarity?"NEG":"POS", flex->Demodulator.zero / (32768.0 * (1 << ZERO_SHIFT)),
+                flex->Demodulator.envelope_count ? flex->Demodulator.envelope_sum / (32768.0 * flex->Demodulator.envelope_count) : 0.0,
+                flex->Modulation.symbol_rate);
           } else {
             verbprintf(2, "FLEX: Unknown Sync code = 0x%04x\n", sync_code);
             flex->State.Current=FLEX_STATE_SYNC1;
@@ -1143,7 +1557,7 @@ static void flex_sym(struct Flex * flex, unsigned char sym) {
         // to each of the four transmitted phases of FLEX interleaved codes.
         int idle=read_data(flex, sym_rectified);
         if (++flex->State.data_count == flex->Sync.baud*1760/1000 || idle) {
-          decode_data(flex);
+          flex_frame_done(flex);
           flex->Demodulator.baud = 1600;
           flex->State.Current=FLEX_STATE_SYNC1;
           flex->State.data_count=0;
@@ -1153,167 +1567,181 @@ static void flex_sym(struct Flex * flex, unsigned char sym) {
   }
 }
 
-int buildSymbol(struct Flex * flex, double sample) {
-        if (flex == NULL) return 0;
-
-        const int64_t phase_max = 100 * flex->Demodulator.sample_freq;                           // Maximum value for phase (calculated to divide by sample frequency without remainder)
-        const int64_t phase_rate = phase_max*flex->Demodulator.baud / flex->Demodulator.sample_freq;      // Increment per baseband sample
-        const double phasepercent = 100.0 *  flex->Demodulator.phase / phase_max;
-
-        /*Update the sample counter*/
-        flex->Demodulator.sample_count++;
-
-        /*Remove DC offset (FIR filter)*/
-        if (flex->State.Current == FLEX_STATE_SYNC1) {
-                flex->Modulation.zero = (flex->Modulation.zero*(FREQ_SAMP*DC_OFFSET_FILTER) + sample) / ((FREQ_SAMP*DC_OFFSET_FILTER) + 1);
-        }
-        sample -= flex->Modulation.zero;
-
-        if (flex->Demodulator.locked) {
-                /*During the synchronisation period, establish the envelope of the signal*/
-                if (flex->State.Current == FLEX_STATE_SYNC1) {
-                        flex->Demodulator.envelope_sum += fabs(sample);
-                        flex->Demodulator.envelope_count++;
-                        flex->Modulation.envelope = flex->Demodulator.envelope_sum / flex->Demodulator.envelope_count;
-                }
-        }
-        else {
-                /*Reset and hold in initial state*/
-                flex->Modulation.envelope = 0;
-                flex->Demodulator.envelope_sum = 0;
-                flex->Demodulator.envelope_count = 0;
-                flex->Demodulator.baud = 1600;
-                flex->Demodulator.timeout = 0;
-                flex->Demodulator.nonconsec = 0;
-                flex->State.Current = FLEX_STATE_SYNC1;
-        }
-
-        /* MID 80% SYMBOL PERIOD */
-        if (phasepercent > 10 && phasepercent <90) {
-                /*Count the number of occurrences of each symbol value for analysis at end of symbol period*/
-                if (sample > 0) {
-                        if (sample > flex->Modulation.envelope*SLICE_THRESHOLD)
-                                flex->Demodulator.symcount[3]++;
-                        else
-                                flex->Demodulator.symcount[2]++;
-                }
-                else {
-                        if (sample < -flex->Modulation.envelope*SLICE_THRESHOLD)
-                                flex->Demodulator.symcount[0]++;
-                        else
-                                flex->Demodulator.symcount[1]++;
-                }
-        }
+/*
+ * Timing lock has been lost, hold everything in its initial state until
+ * the lock pattern comes round again.
+ */
+static void flex_unlock(struct Flex * flex) {
+  flex->Demodulator.locked = 0;
+  flex->Demodulator.envelope_sum = 0;
+  flex->Demodulator.envelope_count = 0;
+  flex->Demodulator.slice = 0;
+  flex->Demodulator.baud = 1600;
+  flex->Demodulator.timeout = 0;
+  flex->Demodulator.nonconsec = 0;
+  flex->State.Current = FLEX_STATE_SYNC1;
+  report_state(flex);
+}
 
-        /* ZERO CROSSING */
-        if ((flex->Demodulator.sample_last<0 && sample >= 0) || (flex->Demodulator.sample_last >= 0 && sample<0)) {
-                /*The phase error has a direction towards the closest symbol boundary*/
-                double phase_error = 0.0;
-                if (phasepercent<50) {
-                        phase_error = flex->Demodulator.phase;
-                }
-                else {
-                        phase_error = flex->Demodulator.phase - phase_max;
-                }
+/*
+ * End of a symbol period: pick the symbol seen most often during it and
+ * hand it on, or look for the lock pattern while not locked.
+ */
+static void flex_symbol(struct demod_state *s) {
+  struct Flex * flex = s->l1.flex;
+
+  flex->Demodulator.nonconsec = 0;
+  flex->Demodulator.symbol_count++;
+  flex->Modulation.symbol_rate = 1.0 * flex->Demodulator.symbol_count*flex->Demodulator.sample_freq / flex->Demodulator.sample_count;
+
+  /*Determine the modal symbol*/
+  int j;
+  int decmax = 0;
+  int modal_symbol = 0;
+  for (j = 0; j<4; j++) {
+    if (flex->Demodulator.symcount[j] > decmax) {
+      modal_symbol = j;
+      decmax = flex->Demodulator.symcount[j];
+    }
+  }
+  flex->Demodulator.symcount[0] = 0;
+  flex->Demodulator.symcount[1] = 0;
+  flex->Demodulator.symcount[2] = 0;
+  flex->Demodulator.symcount[3] = 0;
 
-                /*Phase lock with the signal*/
-                if (flex->Demodulator.locked) {
-                        flex->Demodulator.phase -= phase_error * PHASE_LOCKED_RATE;
-                }
-                else {
-                        flex->Demodulator.phase -= phase_error * PHASE_UNLOCKED_RATE;
-                }
 
-                /*If too many zero crossing occur within the mid 80% then indicate lock has been lost*/
-                if (phasepercent > 10 && phasepercent < 90) {
-                        flex->Demodulator.nonconsec++;
-                        if (flex->Demodulator.nonconsec>20 && flex->Demodulator.locked) {
-                                verbprintf(1, "FLEX: Synchronisation Lost\n");
-                                flex->Demodulator.locked = 0;
-                        }
-                }
-                else {
-                        flex->Demodulator.nonconsec = 0;
-                }
+  if (flex->Demodulator.locked) {
+    /*Process the symbol*/
+    bitdump_rx(s, BITDUMP_FLEX, modal_symbol);
+    flex_sym(flex, modal_symbol);
+  }
+  else {
+    /*Check for lock pattern*/
+    /*Shift symbols into buffer, symbols are converted so that the max and min symbols map to 1 and 2 i.e each contain a single 1 */
+    flex->Demodulator.lock_buf = (flex->Demodulator.lock_buf << 2) | (modal_symbol ^ 0x1);
+    uint64_t lock_pattern = flex->Demodulator.lock_buf ^ 0x6666666666666666ull;
+    uint64_t lock_mask = (1ull << (2 * LOCK_LEN)) - 1;
+    if ((lock_pattern&lock_mask) == 0 || ((~lock_pattern)&lock_mask) == 0) {
+      verbprintf(1, "FLEX: Locked\n");
+      flex->Demodulator.locked = 1;
+      /*Clear the syncronisation buffer*/
+      flex->Demodulator.lock_buf = 0;
+      flex->Demodulator.symbol_count = 0;
+      flex->Demodulator.sample_count = 0;
+    }
+  }
 
-                flex->Demodulator.timeout = 0;
-        }
-        flex->Demodulator.sample_last = sample;
+  /*Time out after X periods with no zero crossing*/
+  if (flex->Demodulator.locked && ++flex->Demodulator.timeout>DEMOD_TIMEOUT) {
+    verbprintf(1, "FLEX: Timeout\n");
+    flex_unlock(flex);
+  }
 
-  /* END OF SYMBOL PERIOD */
-  flex->Demodulator.phase += phase_rate;
+  /*The slicing level follows the envelope established during SYNC1*/
+  if (flex->Demodulator.envelope_count)
+    flex->Demodulator.slice = (flex->Demodulator.envelope_sum * SLICE_Q16 / flex->Demodulator.envelope_count) >> 16;
 
-  if (flex->Demodulator.phase > phase_max) {
-    flex->Demodulator.phase -= phase_max;
-    return 1;
-  } else {
-    return 0;
+  if (flex->Demodulator.rate_baud != flex->Demodulator.baud) {
+    flex->Demodulator.rate_baud = flex->Demodulator.baud;
+    flex->Demodulator.phase_rate = ((uint64_t)flex->Demodulator.baud << 32) / flex->Demodulator.sample_freq;
   }
 
+  report_state(flex);
 }
 
-void Flex_Demodulate(struct Flex * flex, double sample) {
+/*
+ * Symbol recovery over a block of samples. The symbol clock is a 32 bit
+ * phase accumulator that wraps at the end of each symbol, so the middle
+ * 80% of the period and the direction towards the nearest symbol boundary
+ * fall out of plain integer compares. Everything that only changes between
+ * symbols is kept out of the sample loop.
+ */
+void Flex_Demodulate(struct demod_state *s, const short *samples, int length) {
+  struct Flex * flex = s->l1.flex;
   if(flex == NULL) return;
 
-  if (buildSymbol(flex, sample) == 1) {
-                flex->Demodulator.nonconsec = 0;
-    flex->Demodulator.symbol_count++;
-    flex->Modulation.symbol_rate = 1.0 * flex->Demodulator.symbol_count*flex->Demodulator.sample_freq / flex->Demodulator.sample_count;
-
-    /*Determine the modal symbol*/
-    int j;
-    int decmax = 0;
-    int modal_symbol = 0;
-    for (j = 0; j<4; j++) {
-      if (flex->Demodulator.symcount[j] > decmax) {
-        modal_symbol = j;
-        decmax = flex->Demodulator.symcount[j];
-      }
+  struct Flex_Demodulator * dm = &flex->Demodulator;
+  int i;
+
+  for (i = 0; i < length; i++) {
+    const uint32_t phase = dm->phase;
+    const int mid = phase > PHASE_MID_LO && phase < PHASE_MID_HI;
+
+    dm->sample_count++;
+
+    /*Remove DC offset (IIR filter)*/
+    if (flex->State.Current == FLEX_STATE_SYNC1) {
+      dm->zero += ((((int32_t)samples[i] << ZERO_SHIFT) - dm->zero) * (int64_t)ZERO_ALPHA) >> 16;
     }
-    flex->Demodulator.symcount[0] = 0;
-    flex->Demodulator.symcount[1] = 0;
-    flex->Demodulator.symcount[2] = 0;
-    flex->Demodulator.symcount[3] = 0;
+    int sample = samples[i] - (dm->zero >> ZERO_SHIFT);
 
+    /*During the synchronisation period, establish the envelope of the signal*/
+    if (dm->locked && flex->State.Current == FLEX_STATE_SYNC1) {
+      dm->envelope_sum += abs(sample);
+      dm->envelope_count++;
+    }
 
-    if (flex->Demodulator.locked) {
-      /*Process the symbol*/
-      flex_sym(flex, modal_symbol);
+    /* MID 80% SYMBOL PERIOD */
+    if (mid) {
+      /*Count the number of occurrences of each symbol value for analysis at end of symbol period*/
+      if (sample > 0)
+        dm->symcount[sample > dm->slice ? 3 : 2]++;
+      else
+        dm->symcount[sample < -dm->slice ? 0 : 1]++;
     }
-    else {
-      /*Check for lock pattern*/
-      /*Shift symbols into buffer, symbols are converted so that the max and min symbols map to 1 and 2 i.e each contain a single 1 */
-      flex->Demodulator.lock_buf = (flex->Demodulator.lock_buf << 2) | (modal_symbol ^ 0x1);
-      uint64_t lock_pattern = flex->Demodulator.lock_buf ^ 0x6666666666666666ull;
-      uint64_t lock_mask = (1ull << (2 * LOCK_LEN)) - 1;
-      if ((lock_pattern&lock_mask) == 0 || ((~lock_pattern)&lock_mask) == 0) {
-        verbprintf(1, "FLEX: Locked\n");
-        flex->Demodulator.locked = 1;
-        /*Clear the syncronisation buffer*/
-        flex->Demodulator.lock_buf = 0;
-        flex->Demodulator.symbol_count = 0;
-        flex->Demodulator.sample_count = 0;
+
+    /* ZERO CROSSING */
+    if ((dm->sample_last ^ sample) < 0) {
+      /*The phase error has a direction towards the closest symbol boundary*/
+      int64_t phase_error = (int32_t)phase;
+
+      /*Phase lock with the signal*/
+      dm->phase -= (phase_error * (dm->locked ? PHASE_LOCKED_Q16 : PHASE_UNLOCKED_Q16)) >> 16;
+
+      /*If too many zero crossing occur within the mid 80% then indicate lock has been lost*/
+      if (mid) {
+        dm->nonconsec++;
+        if (dm->nonconsec>20 && dm->locked) {
+          verbprintf(1, "FLEX: Synchronisation Lost\n");
+          flex_unlock(flex);
+        }
+      }
+      else {
+        dm->nonconsec = 0;
       }
-    }
 
-    /*Time out after X periods with no zero crossing*/
-    flex->Demodulator.timeout++;
-    if (flex->Demodulator.timeout>DEMOD_TIMEOUT) {
-      verbprintf(1, "FLEX: Timeout\n");
-      flex->Demodulator.locked = 0;
+      dm->timeout = 0;
     }
-  }
+    dm->sample_last = sample;
 
-  report_state(flex);
+    /* END OF SYMBOL PERIOD */
+    dm->phase += dm->phase_rate;
+    if (dm->phase < dm->phase_rate)
+      flex_symbol(s);
+  }
 }
 
 void Flex_Delete(struct Flex * flex) {
   if (flex==NULL) return;
 
+  size_t bytes = sizeof(struct Flex);
+  size_t group_bytes = group_memory(flex);
+#ifdef FLEX_THREADS
+  if (flex->Pool != NULL) {
+    pool_delete(flex->Pool, &bytes, &group_bytes);
+    flex->Pool = NULL;
+  }
+#endif
+  verbprintf(2, "FLEX: %zu bytes in use, %zu of them for group capcodes\n",
+      bytes + group_bytes, group_bytes);
+  group_free(flex);
+
+#ifdef FLEX_BCH_REFERENCE
   if (flex->Decode.BCHCode!=NULL) {
     BCHCode_Delete(flex->Decode.BCHCode);
     flex->Decode.BCHCode=NULL;
   }
+#endif
 
   free(flex);
 }
@@ -1328,21 +1756,29 @@ struct Flex * Flex_New(unsigned int SampleFrequency) {
     // The baud rate of first syncword and FIW is always 1600, so set that
     // rate to start.
     flex->Demodulator.baud = 1600;
+    flex->Demodulator.rate_baud = 1600;
+    flex->Demodulator.phase_rate = (1600ull << 32) / SampleFrequency;
+
+    bch3121_init();
 
-    /*Generator polynomial for BCH3121 Code*/
-    int p[6];
-    p[0] = p[2] = p[5] = 1; p[1] = p[3] = p[4] =0;
-    flex->Decode.BCHCode=BCHCode_New( p, 5, 31, 21, 2);
+#ifdef FLEX_BCH_REFERENCE
+    flex->Decode.BCHCode=bch3121_reference();
     if (flex->Decode.BCHCode == NULL) {
       Flex_Delete(flex);
-      flex=NULL;
+      return NULL;
     }
+#endif
 
     for(int g = 0; g < 17; g++)
     {
       flex->GroupHandler.GroupFrame[g] = -1;
           flex->GroupHandler.GroupCycle[g] = -1;
     }
+
+#ifdef FLEX_THREADS
+    if (flex_threads > 0)
+      flex->Pool = pool_new(flex_threads);
+#endif
   }
 
   return flex;
@@ -1352,10 +1788,22 @@ struct Flex * Flex_New(unsigned int SampleFrequency) {
 static void flex_demod(struct demod_state *s, buffer_t buffer, int length) {
   if (s==NULL) return;
   if (s->l1.flex==NULL) return;
-  int i;
-  for (i=0; i<length; i++) {
-    Flex_Demodulate(s->l1.flex, buffer.fbuffer[i]);
-  }
+#ifdef FLEX_THREADS
+  if (s->l1.flex->Pool != NULL)
+    print_frames(s->l1.flex->Pool);
+#endif
+  Flex_Demodulate(s, buffer.sbuffer, length);
+}
+
+
+/* Bit stream replay enters here, past the symbol recovery */
+void flex_rxsym(struct demod_state *s, unsigned char sym) {
+  if (s==NULL) return;
+#ifdef FLEX_THREADS
+  if (s->l1.flex->Pool != NULL)
+    print_frames(s->l1.flex->Pool);
+#endif
+  flex_sym(s->l1.flex, sym);
 }
 
 
@@ -1375,5 +1823,5 @@ static void flex_deinit(struct demod_state *s) {
 
 
 const struct demod_param demod_flex = {
-  "FLEX", true, FREQ_SAMP, FILTLEN, flex_init, flex_demod, flex_deinit
+  "FLEX", false, FREQ_SAMP, FILTLEN, flex_init, flex_demod, flex_deinit
 };
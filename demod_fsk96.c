@@ -77,6 +77,7 @@ static const float inp_filt[3][24] = {
 static void fsk96_init(struct demod_state *s)
 {
 	hdlc_init(s);
+	rxbits_init(s, hdlc_rxbits, BITDUMP_HDLC);
 	memset(&s->l1.fsk96, 0, sizeof(s->l1.fsk96));
 }
 
@@ -84,6 +85,7 @@ static void fsk96_init(struct demod_state *s)
 
 static void fsk96_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
 	float f;
 	unsigned char curbit;
 	int i;
@@ -112,17 +114,170 @@ static void fsk96_demod(struct demod_state *s, buffer_t buffer, int length)
 				descx = s->l1.fsk96.descram ^ (s->l1.fsk96.descram >> 1);
 				curbit = ((descx >> DESCRAM_TAPSH1) ^ (descx >> DESCRAM_TAPSH2) ^
 					  (descx >> DESCRAM_TAPSH3) ^ 1) & 1;
-				verbprintf(9, " %c ", '0'+curbit);
-				hdlc_rxbit(s, curbit);
+				rxbits_put(s, curbit, buffer.fbuffer - start);
 			}
 		}
 	}
+	rxbits_flush(s);
 }
 
 /* ---------------------------------------------------------------------- */
 
 const struct demod_param demod_fsk9600 = {
-    "FSK9600", true, FREQ_SAMP, FILTLEN, fsk96_init, fsk96_demod, NULL
+    "FSK9600", true, FREQ_SAMP, FILTLEN, fsk96_init, fsk96_demod, hdlc_deinit
+};
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * At 22050 Hz a bit is only 2.3 samples long, hence the upsampling above.
+ * The G3RUH demodulators below want a sample rate of at least four samples
+ * per bit instead. They run a low pass for the raised cosine pulses of a
+ * G3RUH modem over the input, four outputs at a time, and then a DPLL over
+ * each block of filter output. The DPLL locks on to the interpolated zero
+ * crossings, tracking phase and bit rate so that sound card clocks some
+ * 1000 ppm off do not matter, and samples at the interpolated middle of
+ * the bit. The line bits are collected into words, the descrambler undoes
+ * the NRZI coding and the 1 + x^12 + x^17 scrambler on a whole word at once.
+ */
+
+#define G3RUH_TAPS(fs, baud) ((6*(fs)/(baud)+3)/4*4)    /* six bits long */
+#define G3RUH_CUTOFF 0.6        /* of the bit rate */
+#define G3RUH_CHUNK  256        /* filter outputs per DPLL run */
+#define G3RUH_WORD   32         /* line bits descrambled at once */
+#define G3RUH_PGAIN  256        /* phase error taken out per crossing: 1/256 */
+#define G3RUH_IGAIN  16384      /* and added to the bit rate: 1/16384 */
+
+static void g3ruh_init(struct demod_state *s, unsigned int fs, unsigned int baud)
+{
+	struct l1_state_g3ruh *g = &s->l1.g3ruh;
+	double x, w, sum = 0;
+	unsigned int i;
+
+	hdlc_init(s);
+	rxbits_init(s, hdlc_rxbits, BITDUMP_HDLC);
+	memset(g, 0, sizeof(*g));
+	g->ntaps = G3RUH_TAPS(fs, baud);
+	g->sphaseinc = (uint32_t)(4294967296.0 * baud / fs);
+	g->freqmax = g->sphaseinc / 64;
+	/* Hamming windowed sinc */
+	for (i = 0; i < g->ntaps; i++) {
+		x = (i - (g->ntaps - 1) / 2.0) * 2.0 * G3RUH_CUTOFF * baud / fs;
+		w = 0.54 - 0.46 * cos(2.0 * M_PI * (i + 0.5) / g->ntaps);
+		g->taps[i] = w * (fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x));
+		sum += g->taps[i];
+	}
+	for (i = 0; i < g->ntaps; i++)
+		g->taps[i] /= sum;
+}
+
+static inline void g3ruh_filter(const float *x, const float *h, unsigned int ntaps,
+				float *y, unsigned int n)
+{
+	unsigned int i = 0;
+
+#ifdef HAVE_VECTORS
+	for (; i + 4 <= n; i += 4) {
+		v4sf acc = { 0, 0, 0, 0 }, xv;
+		unsigned int k;
+
+		for (k = 0; k < ntaps; k++) {
+			memcpy(&xv, x + i + k, sizeof(xv));
+			acc += xv * h[k];
+		}
+		memcpy(y + i, &acc, sizeof(acc));
+	}
+#endif
+	for (; i < n; i++)
+		y[i] = mac(x + i, h, ntaps);
+}
+
+static void g3ruh_descramble(struct demod_state *s, unsigned int n, const unsigned short *offs)
+{
+	uint64_t x = s->l1.g3ruh.line ^ (s->l1.g3ruh.line >> 1);
+	uint64_t d = ~(x ^ (x >> DESCRAM_TAPSH2) ^ (x >> DESCRAM_TAPSH1));
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		rxbits_put(s, (d >> (n - 1 - i)) & 1, offs[i]);
+}
+
+static void g3ruh_demod(struct demod_state *s, buffer_t buffer, int length)
+{
+	struct l1_state_g3ruh *g = &s->l1.g3ruh;
+	float y[G3RUH_CHUNK], prev, cur;
+	unsigned short offs[G3RUH_WORD];
+	unsigned int n, i, nw = 0, pos = 0;
+	uint32_t ph, inc, wrap, cross;
+	int32_t err;
+
+	for (; length > 0; length -= n, pos += n) {
+		n = length < G3RUH_CHUNK ? length : G3RUH_CHUNK;
+		g3ruh_filter(buffer.fbuffer + pos, g->taps, g->ntaps, y, n);
+		for (i = 0; i < n; i++) {
+			cur = y[i];
+			prev = g->last;
+			g->last = cur;
+			ph = g->sphase;
+			inc = g->sphaseinc + g->freq;
+			g->sphase += inc;
+			wrap = g->sphase;
+			if ((prev > 0) != (cur > 0)) {
+				/* a zero crossing belongs half way between two bits */
+				cross = ph + (uint32_t)(inc * (prev / (prev - cur)));
+				err = (int32_t)(cross - 0x80000000u);
+				g->sphase -= err / G3RUH_PGAIN;
+				g->freq -= err / G3RUH_IGAIN;
+				if (g->freq > g->freqmax)
+					g->freq = g->freqmax;
+				else if (g->freq < -g->freqmax)
+					g->freq = -g->freqmax;
+			}
+			if (wrap >= ph)
+				continue;
+			/* the bit clock wrapped since the last sample, wrap ago */
+			g->line = (g->line << 1) |
+				(cur - (cur - prev) * ((float)wrap / inc) > 0);
+			offs[nw] = pos + i;
+			if (++nw == G3RUH_WORD) {
+				g3ruh_descramble(s, nw, offs);
+				nw = 0;
+			}
+		}
+	}
+	g3ruh_descramble(s, nw, offs);
+	rxbits_flush(s);
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void fsk96_48_init(struct demod_state *s)
+{
+	g3ruh_init(s, 48000, 9600);
+}
+
+const struct demod_param demod_fsk9600_48 = {
+    "FSK9600_48", true, 48000, G3RUH_TAPS(48000, 9600), fsk96_48_init, g3ruh_demod, hdlc_deinit
+};
+
+/* five samples per bit as at 48 kHz, so the same filter length */
+
+static void fsk192_init(struct demod_state *s)
+{
+	g3ruh_init(s, 96000, 19200);
+}
+
+const struct demod_param demod_fsk19200 = {
+    "FSK19200", true, 96000, G3RUH_TAPS(96000, 19200), fsk192_init, g3ruh_demod, hdlc_deinit
+};
+
+static void fsk384_init(struct demod_state *s)
+{
+	g3ruh_init(s, 192000, 38400);
+}
+
+const struct demod_param demod_fsk38400 = {
+    "FSK38400", true, 192000, G3RUH_TAPS(192000, 38400), fsk384_init, g3ruh_demod, hdlc_deinit
 };
 
 /* ---------------------------------------------------------------------- */
@@ -40,6 +40,7 @@
 static void hapn48_init(struct demod_state *s)
 {
 	hdlc_init(s);
+	rxbits_init(s, hdlc_rxbits, BITDUMP_HDLC);
 	memset(&s->l1.hapn48, 0, sizeof(s->l1.hapn48));
 }
 
@@ -47,6 +48,7 @@ static void hapn48_init(struct demod_state *s)
 
 static void hapn48_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
 	unsigned int curbit;
 
 	for (; length > 0; length--, buffer.fbuffer++) {
@@ -88,16 +90,16 @@ static void hapn48_demod(struct demod_state *s, buffer_t buffer, int length)
 		if (s->l1.hapn48.sphase >= 0x10000) {
 			s->l1.hapn48.sphase &= 0xffff;
 			curbit = ((s->l1.hapn48.shreg >> 4) ^ s->l1.hapn48.shreg ^ 1) & 1;
-			verbprintf(9, " %c ", '0'+curbit);
-			hdlc_rxbit(s, curbit);
+			rxbits_put(s, curbit, buffer.fbuffer - start);
 		}
 	}
+	rxbits_flush(s);
 }
 
 /* ---------------------------------------------------------------------- */
 
 const struct demod_param demod_hapn4800 = {
-    "HAPN4800", true, FREQ_SAMP, 3, hapn48_init, hapn48_demod, NULL
+    "HAPN4800", true, FREQ_SAMP, 3, hapn48_init, hapn48_demod, hdlc_deinit
 };
 
 /* ---------------------------------------------------------------------- */
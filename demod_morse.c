@@ -7,13 +7,28 @@
  *
  *-----------------------------------------------------------------------*/
 #include "multimon.h"
+#include "filter.h"
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 #define FREQ_SAMP  22050
 
+// The envelope is summed over blocks of DECIM samples, everything after
+// that runs at MORSE_RATE, which still resolves CW timing to under 1ms.
+// DECIM must be a multiple of 8.
+#define DECIM      16
+#define MORSE_RATE (FREQ_SAMP / DECIM)
+#define TIMING_STEP (50 / DECIM)            // auto timing adjusts by ~2ms
+
 #define SMOOTHING_MAGNITUDE 9
 #define GAIN 1
 #define SQUELCH 500
@@ -155,11 +170,11 @@ typedef struct dec_ret_t
 } dec_ret_t;
 
 // Binary search is crazy fast! 0.01% of our CPU time. O(log n) ftw!
-static inline dec_ret_t decode_character(const struct demod_state * restrict const s)
+static inline dec_ret_t decode_character(const struct l1_state_morse * restrict const m)
 {
     int_fast16_t min = 0;
     int_fast16_t max = NUM_ELEMENTS(morse_codes) - 1;
-    uint64_t sequence = s->l1.morse.current_sequence;
+    uint64_t sequence = m->current_sequence;
     
     while (max >= min) // Search
     {
@@ -183,165 +198,249 @@ static inline dec_ret_t decode_character(const struct demod_state * restrict con
     return rtn;
 }
 
-// Low pass filter - eats 19.4% of the CPU time according to profiling
-// It's a basic IIR filter optimized for integer operation while
-// minimizing the rounding error.
+// Sum of abs(in[]) over each of nblk blocks of DECIM samples. abs() of
+// -32768 wraps to 0x8000, which is right when read as unsigned.
+static void envelope(int32_t * restrict out, const short * restrict in, int nblk)
+{
+    for(int b = 0; b < nblk; b++, in += DECIM)
+    {
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        for(int i = 0; i < DECIM; i += 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+            __m128i sign = _mm_srai_epi16(x, 15);
+            __m128i a = _mm_sub_epi16(_mm_xor_si128(x, sign), sign);
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(a, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(a, zero));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        out[b] = _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        uint32x4_t acc = vdupq_n_u32(0);
+        for(int i = 0; i < DECIM; i += 8)
+            acc = vpadalq_u16(acc, vreinterpretq_u16_s16(vabsq_s16(vld1q_s16(in + i))));
+        uint64x2_t sum = vpaddlq_u32(acc);
+        out[b] = vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+#else
+        int32_t acc = 0;
+        for(int i = 0; i < DECIM; i++)
+            acc += abs(in[i]);
+        out[b] = acc;
+#endif
+    }
+}
+
+// Low pass filter, the same first order IIR as it was at FREQ_SAMP (where it
+// ate 19.4% of the CPU time), with the coefficient adjusted to MORSE_RATE.
 static inline int_fast32_t low_pass(const int_fast32_t last_filtered,
                                     const int_fast32_t new_sample,
-                                    const int_fast16_t strength)
+                                    const int_fast32_t coef)
 {
-    return ((last_filtered << strength) + 
-            new_sample - last_filtered) >> strength;
+    return last_filtered + (int_fast32_t)(((int64_t)(new_sample - last_filtered) * coef) >> 16);
 }
 
 // Probably a lot room for improvements here
-// Another 19.5% of our precious CPU time. It's optional though.
-static inline void auto_threshold(struct demod_state * restrict const s)
+// It's optional though.
+static inline void auto_threshold(struct l1_state_morse * restrict const m)
 {
     // Hackish solution in order to have the threshold adjust.
     // The highest known amplitude bleeds 20 times 0.1%, per second.
-    s->l1.morse.threshold_ctr = (s->l1.morse.threshold_ctr+1) % (FREQ_SAMP / 20);
-    if(!s->l1.morse.threshold_ctr && s->l1.morse.signal_max > 0)
+    if(++m->threshold_ctr >= MORSE_RATE / 20)
     {
-        s->l1.morse.signal_max = s->l1.morse.signal_max * 999 / 1000;
-        s->l1.morse.detection_threshold = s->l1.morse.signal_max*AUTO_THRESHOLD_MULT;
+        m->threshold_ctr = 0;
+        if(m->signal_max > 0)
+        {
+            m->signal_max = m->signal_max * 999 / 1000;
+            m->detection_threshold = m->signal_max*AUTO_THRESHOLD_MULT;
+        }
     }
     
     // Check for a higher upper limit
-    if(s->l1.morse.filtered > s->l1.morse.signal_max)
+    if(m->filtered > m->signal_max)
     {
-        s->l1.morse.signal_max = s->l1.morse.filtered;
-        s->l1.morse.detection_threshold = s->l1.morse.signal_max*AUTO_THRESHOLD_MULT;
+        m->signal_max = m->filtered;
+        m->detection_threshold = m->signal_max*AUTO_THRESHOLD_MULT;
     }
     
-    // Prevent threshold from dropping below SQUELCH
-    if(s->l1.morse.detection_threshold < SQUELCH)
-        s->l1.morse.detection_threshold = SQUELCH;
+    // Prevent threshold from dropping below the squelch
+    if(m->detection_threshold < m->squelch)
+        m->detection_threshold = m->squelch;
 }
 
 // TODO: Come up with a more fancy solution!
-static inline void auto_timing(const bool state, struct demod_state * restrict const s)
+static inline void auto_timing(const bool state, struct l1_state_morse * restrict const m)
 {
-    if(s->l1.morse.samples_since_change < FREQ_SAMP / (1000 / 120)) //120ms
+    if(m->samples_since_change < MORSE_RATE / (1000 / 120)) //120ms
     {
         if(state == LOW)
         {
-            if(s->l1.morse.time_unit_gaps_samples > s->l1.morse.samples_since_change)
-                s->l1.morse.time_unit_gaps_samples -= 50;
-            else s->l1.morse.time_unit_gaps_samples += 50;
+            if(m->time_unit_gaps_samples > m->samples_since_change)
+                m->time_unit_gaps_samples -= TIMING_STEP;
+            else m->time_unit_gaps_samples += TIMING_STEP;
         }
         else
         {
-            if(s->l1.morse.time_unit_dit_dah_samples > s->l1.morse.samples_since_change)
-                s->l1.morse.time_unit_dit_dah_samples -= 50;
-            else s->l1.morse.time_unit_dit_dah_samples += 50;
+            if(m->time_unit_dit_dah_samples > m->samples_since_change)
+                m->time_unit_dit_dah_samples -= TIMING_STEP;
+            else m->time_unit_dit_dah_samples += TIMING_STEP;
         }
     }
 }
 
-// This one gets about 60% of our cycles.
-static void morse_demod(struct demod_state * restrict const s,
-                        const buffer_t buffer, const int length)
+// Decoded text goes to stdout, or collects in m->text if there is one.
+static void morse_put(struct l1_state_morse * restrict const m, const char *str)
 {
-    for(int i = 0; i < length; i++)
+    if(!m->text)
     {
-        // A low-pass is nice, though we could add a high-pass in order to get a band-pass :)
-        // abs() when combined with the low-pass works as a peak detector
-        s->l1.morse.filtered = low_pass(s->l1.morse.filtered, (int_fast32_t)abs(buffer.sbuffer[i]) * GAIN,
-                                       s->l1.morse.lowpass_strength);
-        
-        // Don't count too far
-        if(s->l1.morse.samples_since_change < INT_FAST32_MAX/1000)
-            s->l1.morse.samples_since_change++;
-        
-        if(!cw_disable_auto_threshold) auto_threshold(s);
-        
-        int_fast8_t oldstate = s->l1.morse.current_state;
-        
-        // Reject change for holdoff period
-        if(s->l1.morse.samples_since_change > s->l1.morse.holdoff_samples)
-            s->l1.morse.current_state = s->l1.morse.filtered > s->l1.morse.detection_threshold;
-        
-        if(SPAM_SAMPLES) verbprintf(0, " %d", s->l1.morse.filtered);
-        if(SPAM_STATE) verbprintf(0, " %s", s->l1.morse.current_state?"#":".");
-        
-        int_fast8_t statechange = oldstate != s->l1.morse.current_state;
-        int_fast8_t timeout = s->l1.morse.samples_since_change == 5*s->l1.morse.time_unit_gaps_samples;
+        verbprintf(0, "%s", str);
+        return;
+    }
+    while(*str && m->text_len < m->text_size - 1)
+        m->text[m->text_len++] = *str++;
+    m->text[m->text_len] = '\0';
+}
+
+// Runs at MORSE_RATE, level is the mean of abs() over the last DECIM samples
+// or, in the skimmer, the equivalent of that for one FFT bin.
+static void morse_step(struct l1_state_morse * restrict const m, const int32_t level)
+{
+    // A low-pass is nice, though we could add a high-pass in order to get a band-pass :)
+    // abs() when combined with the low-pass works as a peak detector
+    m->filtered = low_pass(m->filtered, level * GAIN,
+                                   m->lowpass_coef);
+    
+    // Don't count too far
+    if(m->samples_since_change < INT_FAST32_MAX/1000)
+        m->samples_since_change++;
+    
+    if(!cw_disable_auto_threshold) auto_threshold(m);
+    
+    int_fast8_t oldstate = m->current_state;
+    
+    // Reject change for holdoff period
+    if(m->samples_since_change > m->holdoff_samples)
+        m->current_state = m->filtered > m->detection_threshold;
+    
+    if(SPAM_SAMPLES) verbprintf(0, " %d", m->filtered);
+    if(SPAM_STATE) verbprintf(0, " %s", m->current_state?"#":".");
+    
+    int_fast8_t statechange = oldstate != m->current_state;
+    int_fast8_t timeout = m->samples_since_change == 5*m->time_unit_gaps_samples;
+    
+    // Enter on state transition or timeout
+    if(statechange || timeout)
+    {
+        // Ignore glitches only lasting the holdoff period
+        if(m->samples_since_change == m->holdoff_samples+1)
+        {
+            if(DEBUG) verbprintf(0, "<GLITCH %dms>", m->samples_since_change * 1000 / MORSE_RATE);
+            m->glitches++;
+            goto reset_samples;
+        }
         
-        // Enter on state transition or timeout
-        if(statechange || timeout)
+        if(oldstate == LOW)
         {
-            // Ignore glitches only lasting the holdoff period
-            if(s->l1.morse.samples_since_change == s->l1.morse.holdoff_samples+1)
+            // Check whether it was just a inter DIT/DAH gap, else decode
+            if(m->samples_since_change >= 2*m->time_unit_gaps_samples)
             {
-                if(DEBUG) verbprintf(0, "<GLITCH %dms>", s->l1.morse.samples_since_change * 1000 / FREQ_SAMP);
-                s->l1.morse.glitches++;
-                goto reset_samples;
-            }
-            
-            if(oldstate == LOW)
-            {
-                // Check whether it was just a inter DIT/DAH gap, else decode
-                if(s->l1.morse.samples_since_change >= 2*s->l1.morse.time_unit_gaps_samples)
+                dec_ret_t rtn = {NULL,"",false};
+                if(m->current_sequence)
                 {
-                    dec_ret_t rtn = {NULL,"",false};
-                    if(s->l1.morse.current_sequence)
-                    {
-                        rtn = decode_character(s);
-                        if(SHOW_FAILED_DECODES) verbprintf(0, "%s", rtn.string_ptr);
-                        else if(rtn.status) verbprintf(0, "%s", rtn.string_ptr);
-                        
-                        if(rtn.status) s->l1.morse.decoded_chars++;
-                        else s->l1.morse.erroneous_chars++;
-                        s->l1.morse.current_sequence = 0; // Start a new sequence
-                    }
+                    rtn = decode_character(m);
+                    if(SHOW_FAILED_DECODES || rtn.status) morse_put(m, rtn.string_ptr);
                     
-                    if(s->l1.morse.samples_since_change < 5*s->l1.morse.time_unit_gaps_samples) // End of Char
-                    {
-                        if(DEBUG) verbprintf(0, "<EOC %dms>", s->l1.morse.samples_since_change * 1000 / FREQ_SAMP);
-                    }
-                    else if(timeout) // End of word - timeout
-                    {
-                        if(rtn.status)
-                            verbprintf(0," "); //Don't print additional spaces if last character failed to decode
-                        if(DEBUG) verbprintf(0, "<EOW %dms>", s->l1.morse.samples_since_change * 1000 / FREQ_SAMP);
-                        goto end; // Don't reset samples, since there wasn't any change in state.
-                    }
-                } // It was just a inter DIT/DAH gap
-                else if(DEBUG) verbprintf(0, "<GAP %dms>", s->l1.morse.samples_since_change * 1000 / FREQ_SAMP);
-            }
-            else // Last state was either DIT or DAH
-            {
-                if(s->l1.morse.samples_since_change < 2*s->l1.morse.time_unit_dit_dah_samples)
+                    if(rtn.status) m->decoded_chars++;
+                    else m->erroneous_chars++;
+                    m->current_sequence = 0; // Start a new sequence
+                }
+                
+                if(m->samples_since_change < 5*m->time_unit_gaps_samples) // End of Char
                 {
-                    s->l1.morse.current_sequence = (s->l1.morse.current_sequence << 2) | DIT;
-                    if(DEBUG) verbprintf(0, "<DIT %dms>", s->l1.morse.samples_since_change * 1000 / FREQ_SAMP);
+                    if(DEBUG) verbprintf(0, "<EOC %dms>", m->samples_since_change * 1000 / MORSE_RATE);
                 }
-                else 
+                else if(timeout) // End of word - timeout
                 {
-                    s->l1.morse.current_sequence = (s->l1.morse.current_sequence << 2) | DAH;
-                    if(DEBUG) verbprintf(0, "<DAH %dms>", s->l1.morse.samples_since_change * 1000 / FREQ_SAMP);
+                    if(rtn.status)
+                        morse_put(m, " "); //Don't print additional spaces if last character failed to decode
+                    if(DEBUG) verbprintf(0, "<EOW %dms>", m->samples_since_change * 1000 / MORSE_RATE);
+                    goto end; // Don't reset samples, since there wasn't any change in state.
                 }
+            } // It was just a inter DIT/DAH gap
+            else if(DEBUG) verbprintf(0, "<GAP %dms>", m->samples_since_change * 1000 / MORSE_RATE);
+        }
+        else // Last state was either DIT or DAH
+        {
+            if(m->samples_since_change < 2*m->time_unit_dit_dah_samples)
+            {
+                m->current_sequence = (m->current_sequence << 2) | DIT;
+                if(DEBUG) verbprintf(0, "<DIT %dms>", m->samples_since_change * 1000 / MORSE_RATE);
             }
-            
-            if(!cw_disable_auto_timing) auto_timing(oldstate, s);
+            else 
+            {
+                m->current_sequence = (m->current_sequence << 2) | DAH;
+                if(DEBUG) verbprintf(0, "<DAH %dms>", m->samples_since_change * 1000 / MORSE_RATE);
+            }
+        }
+        
+        if(!cw_disable_auto_timing) auto_timing(oldstate, m);
 reset_samples:
-            s->l1.morse.samples_since_change = 0; // State has changed, restart counting
+        m->samples_since_change = 0; // State has changed, restart counting
 end:;
+    }
+}
+
+static void morse_demod(struct demod_state * restrict const s,
+                        const buffer_t buffer, const int length)
+{
+    int32_t env[256];
+    const short *in = buffer.sbuffer;
+    int n = length, i;
+
+    // Finish the block left over from the last buffer
+    while(s->l1.morse.env_cnt && n > 0)
+    {
+        s->l1.morse.env_acc += abs(*in++);
+        n--;
+        if(++s->l1.morse.env_cnt == DECIM)
+        {
+            morse_step(&s->l1.morse, s->l1.morse.env_acc / DECIM);
+            s->l1.morse.env_acc = s->l1.morse.env_cnt = 0;
         }
     }
+    while(n >= DECIM)
+    {
+        int nblk = n / DECIM;
+        if(nblk > (int)NUM_ELEMENTS(env)) nblk = NUM_ELEMENTS(env);
+        envelope(env, in, nblk);
+        for(i = 0; i < nblk; i++)
+            morse_step(&s->l1.morse, env[i] / DECIM);
+        in += nblk * DECIM;
+        n -= nblk * DECIM;
+    }
+    for(; n > 0; n--, s->l1.morse.env_cnt++)
+        s->l1.morse.env_acc += abs(*in++);
 }
 
-static void morse_init(struct demod_state * restrict s)
+static void morse_state_init(struct l1_state_morse * restrict const m)
 {
-    memset(&s->l1.morse, 0, sizeof(s->l1.morse));
-    s->l1.morse.time_unit_dit_dah_samples = FREQ_SAMP / (1000 / cw_dit_length);
-    s->l1.morse.time_unit_gaps_samples = FREQ_SAMP / (1000 / cw_gap_length);
-    s->l1.morse.detection_threshold = cw_threshold;
-    s->l1.morse.lowpass_strength = SMOOTHING_MAGNITUDE;
-    if(HOLDOFF_MS) s->l1.morse.holdoff_samples = FREQ_SAMP / (1000 / HOLDOFF_MS);
+    memset(m, 0, sizeof(*m));
+    m->time_unit_dit_dah_samples = MORSE_RATE / (1000 / cw_dit_length);
+    m->time_unit_gaps_samples = MORSE_RATE / (1000 / cw_gap_length);
+    m->detection_threshold = cw_threshold;
+    // what 1/2^SMOOTHING_MAGNITUDE per sample adds up to over DECIM samples
+    m->lowpass_coef = 65536.0 * (1.0 - pow(1.0 - 1.0 / (1 << SMOOTHING_MAGNITUDE), DECIM)) + 0.5;
+    if(HOLDOFF_MS) m->holdoff_samples = MORSE_RATE / (1000 / HOLDOFF_MS);
     
-    s->l1.morse.signal_max = SQUELCH;
+    m->signal_max = SQUELCH;
+    m->squelch = SQUELCH;
+}
+
+static void morse_init(struct demod_state * restrict s)
+{
+    morse_state_init(&s->l1.morse);
 }
 
 static void morse_deinit(struct demod_state * const restrict s)
@@ -353,11 +452,274 @@ static void morse_deinit(struct demod_state * const restrict s)
                s->l1.morse.glitches,
                s->l1.morse.erroneous_chars,
                s->l1.morse.decoded_chars,
-               s->l1.morse.time_unit_gaps_samples * 1000 / FREQ_SAMP,
-               s->l1.morse.time_unit_dit_dah_samples * 1000 / FREQ_SAMP);
+               s->l1.morse.time_unit_gaps_samples * 1000 / MORSE_RATE,
+               s->l1.morse.time_unit_dit_dah_samples * 1000 / MORSE_RATE);
     verbprintf(0, "\n");
 }
 
 const struct demod_param demod_morse = {
     "MORSE_CW", false, FREQ_SAMP, 0, morse_init, morse_demod, morse_deinit
 };
+
+// CW skimmer. A Hann windowed 256 point FFT every SKIM_HOP samples splits
+// the passband into 86 Hz bins. A bin whose smoothed level stands SKIM_SNR
+// above its own noise floor, and above its neighbours, for SKIM_HOLD frames
+// gets a channel with its own state machine, fed with that bin's level.
+// One FFT serves all channels. The state machines still run at MORSE_RATE,
+// each frame is fed to them SKIM_HOP / DECIM times; with a 12ms window
+// there is nothing to gain from more frames. Channels that stay quiet for
+// SKIM_IDLE are given up.
+#define SKIM_FFT      256
+#define SKIM_HALF     (SKIM_FFT / 2)
+#define SKIM_HOP      (2 * DECIM)
+#define SKIM_RATE     (FREQ_SAMP / SKIM_HOP)
+#define SKIM_BIN_LO   (200 * SKIM_FFT / FREQ_SAMP)
+#define SKIM_BIN_HI   (3500 * SKIM_FFT / FREQ_SAMP)
+#define SKIM_CHANNELS 16
+#define SKIM_SNR      5.0f          // level over the floor, 14dB
+#define SKIM_MIN      4.0f          // never trigger on digital silence
+#define SKIM_SETTLE   (SKIM_RATE / 4)   // let the floor settle first
+#define SKIM_HOLD     7             // ~10ms, ignores key clicks
+#define SKIM_IDLE     (3 * MORSE_RATE)
+#define SKIM_LINE     40            // print a line after this many chars
+#define SKIM_TEXT     80
+
+// The butterflies of the later FFT stages run four at a time, as v4sf
+#ifdef HAVE_VECTORS
+#define SKIM_ALIGN __attribute__((aligned(16)))
+#else
+#define SKIM_ALIGN
+#endif
+
+struct skim_chan {
+    struct l1_state_morse m;
+    int bin;                        // 0 if the channel is free
+    unsigned int hz;
+    char text[SKIM_TEXT];
+};
+
+struct cw_skimmer {
+    float re[SKIM_HALF] SKIM_ALIGN, im[SKIM_HALF] SKIM_ALIGN;
+    float twr[SKIM_HALF] SKIM_ALIGN, twi[SKIM_HALF] SKIM_ALIGN;
+    float win[SKIM_FFT];            // Hann window, scaled to morse levels
+    float unr[SKIM_HALF], uni[SKIM_HALF];
+    unsigned char rev[SKIM_HALF];
+    float mag[SKIM_BIN_HI + 2], sm[SKIM_BIN_HI + 2];
+    float slow[SKIM_BIN_HI + 2], floor[SKIM_BIN_HI + 2];
+    unsigned short hits[SKIM_BIN_HI + 2];
+    int frames;                     // counts up to SKIM_SETTLE
+    int phase;                      // where the next frame starts
+    unsigned int opened;
+    struct skim_chan ch[SKIM_CHANNELS];
+};
+
+// Real input FFT: the 256 samples are packed into a 128 point complex FFT
+// as even/odd pairs, then only the bins we look at are unpacked.
+static void skim_fft(struct cw_skimmer * restrict k, const float * restrict x)
+{
+    float * restrict re = k->re, * restrict im = k->im;
+    int n, len, i, j;
+
+    for(n = 0; n < SKIM_HALF; n++)
+    {
+        re[k->rev[n]] = x[2 * n] * k->win[2 * n];
+        im[k->rev[n]] = x[2 * n + 1] * k->win[2 * n + 1];
+    }
+    // twr/twi hold the twiddles of each stage in a row, from index half
+    for(len = 2; len <= SKIM_HALF; len <<= 1)
+    {
+        int half = len / 2;
+        const float *twr = k->twr + half, *twi = k->twi + half;
+        for(i = 0; i < SKIM_HALF; i += len)
+        {
+            float * restrict ar = re + i, * restrict ai = im + i;
+            float * restrict br = ar + half, * restrict bi = ai + half;
+            j = 0;
+#ifdef HAVE_VECTORS
+            for(; j + 4 <= half; j += 4)
+            {
+                v4sf wr = *(const v4sf *)(twr + j), wi = *(const v4sf *)(twi + j);
+                v4sf xr = *(v4sf *)(br + j), xi = *(v4sf *)(bi + j);
+                v4sf yr = *(v4sf *)(ar + j), yi = *(v4sf *)(ai + j);
+                v4sf tr = xr * wr - xi * wi, ti = xr * wi + xi * wr;
+                *(v4sf *)(br + j) = yr - tr;
+                *(v4sf *)(bi + j) = yi - ti;
+                *(v4sf *)(ar + j) = yr + tr;
+                *(v4sf *)(ai + j) = yi + ti;
+            }
+#endif
+            for(; j < half; j++)
+            {
+                float tr = br[j] * twr[j] - bi[j] * twi[j];
+                float ti = br[j] * twi[j] + bi[j] * twr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+    for(n = SKIM_BIN_LO - 1; n <= SKIM_BIN_HI + 1; n++)
+    {
+        // even part (Z[n] + Z*[N-n]) / 2, odd part (Z[n] - Z*[N-n]) / 2i
+        float er = re[n] + re[SKIM_HALF - n], ei = im[n] - im[SKIM_HALF - n];
+        float odr = im[n] + im[SKIM_HALF - n], odi = re[SKIM_HALF - n] - re[n];
+        float xr = er + odr * k->unr[n] - odi * k->uni[n];
+        float xi = ei + odr * k->uni[n] + odi * k->unr[n];
+        k->mag[n] = 0.5f * sqrtf(xr * xr + xi * xi);
+    }
+}
+
+static void skim_flush(struct skim_chan * restrict c)
+{
+    while(c->m.text_len && c->text[c->m.text_len - 1] == ' ')
+        c->m.text_len--;
+    if(c->m.text_len)
+    {
+        c->text[c->m.text_len] = '\0';
+        verbprintf(0, "CW %4u Hz: %s\n", c->hz, c->text);
+    }
+    c->m.text_len = 0;
+}
+
+static void skim_open(struct cw_skimmer * restrict k, int bin)
+{
+    struct skim_chan *c = NULL;
+    int i;
+
+    for(i = 0; i < SKIM_CHANNELS; i++)
+    {
+        if(k->ch[i].bin && abs(k->ch[i].bin - bin) <= 2)
+            return;                 // leakage of a signal we already follow
+        if(!k->ch[i].bin && !c)
+            c = &k->ch[i];
+    }
+    if(!c)
+        return;
+    morse_state_init(&c->m);
+    c->m.text = c->text;
+    c->m.text_size = SKIM_TEXT;
+    c->m.squelch = 4 * k->floor[bin] + 1;
+    c->m.signal_max = k->sm[bin];
+    c->m.filtered = k->sm[bin];
+    c->m.detection_threshold = k->sm[bin] * AUTO_THRESHOLD_MULT;
+    // it has been keyed down since the bin first stood out
+    c->m.current_state = HIGH;
+    c->m.samples_since_change = SKIM_HOLD * SKIM_HOP / DECIM;
+    c->bin = bin;
+    // parabolic interpolation between the bins
+    float a = k->sm[bin - 1], b = k->sm[bin], d = k->sm[bin + 1];
+    float frac = a - 2 * b + d < 0 ? 0.5f * (a - d) / (a - 2 * b + d) : 0;
+    c->hz = (unsigned int)((bin + frac) * FREQ_SAMP / SKIM_FFT / 10 + 0.5f) * 10;
+    k->opened++;
+    verbprintf(2, "CW %4u Hz: opened channel %d\n", c->hz, (int)(c - k->ch));
+}
+
+static void skim_frame(struct cw_skimmer * restrict k, const float * restrict x)
+{
+    int n, i, j;
+
+    skim_fft(k, x);
+    for(n = SKIM_BIN_LO - 1; n <= SKIM_BIN_HI + 1; n++)
+    {
+        k->sm[n] += (k->mag[n] - k->sm[n]) * 0.25f;
+        // The floor follows the slow level down at once and creeps up
+        // ~1.5dB/s. The slow level averages over ~50ms, the minimum of
+        // anything faster would sit far below the mean of the noise.
+        k->slow[n] += (k->mag[n] - k->slow[n]) * (1.0f / 32);
+        if(k->slow[n] < k->floor[n] || k->frames < SKIM_SETTLE)
+            k->floor[n] = k->slow[n];
+        else
+            k->floor[n] *= 1.0f + 1.0f / 2048;
+    }
+    if(k->frames < SKIM_SETTLE)
+    {
+        k->frames++;
+        return;
+    }
+    for(n = SKIM_BIN_LO; n <= SKIM_BIN_HI; n++)
+    {
+        if(k->sm[n] > k->floor[n] * SKIM_SNR && k->sm[n] > SKIM_MIN &&
+           k->sm[n] >= k->sm[n - 1] && k->sm[n] > k->sm[n + 1])
+        {
+            if(++k->hits[n] == SKIM_HOLD)
+                skim_open(k, n);
+        }
+        else
+            k->hits[n] = 0;
+    }
+    for(i = 0; i < SKIM_CHANNELS; i++)
+    {
+        struct skim_chan *c = &k->ch[i];
+        if(!c->bin)
+            continue;
+        for(j = 0; j < SKIM_HOP / DECIM; j++)
+            morse_step(&c->m, k->mag[c->bin]);
+        if(c->m.text_len >= SKIM_TEXT - 36 ||
+           (c->m.text_len >= SKIM_LINE && c->text[c->m.text_len - 1] == ' '))
+            skim_flush(c);
+        if(c->m.current_state == LOW && c->m.samples_since_change > SKIM_IDLE)
+        {
+            skim_flush(c);
+            verbprintf(2, "CW %4u Hz: closed channel %d\n", c->hz, i);
+            c->bin = 0;
+        }
+    }
+}
+
+static void skim_init(struct demod_state * restrict s)
+{
+    struct cw_skimmer *k = calloc(1, sizeof(*k));
+    int n, b;
+
+    if(!k)
+    {
+        perror("calloc");
+        exit(10);
+    }
+    // a sine of amplitude A gives A*N/4 in its bin, the wideband decoder
+    // sees a mean abs() of 2A/pi, in 16 bit units
+    for(n = 0; n < SKIM_FFT; n++)
+        k->win[n] = (0.5 - 0.5 * cos(2.0 * M_PI * n / SKIM_FFT)) * 32768.0 * 8.0 / (M_PI * SKIM_FFT);
+    for(b = 1; b < SKIM_HALF; b <<= 1)
+        for(n = 0; n < b; n++)
+        {
+            k->twr[b + n] = cos(M_PI * n / b);
+            k->twi[b + n] = -sin(M_PI * n / b);
+        }
+    for(n = 0; n < SKIM_HALF; n++)
+    {
+        k->unr[n] = cos(2.0 * M_PI * n / SKIM_FFT);
+        k->uni[n] = -sin(2.0 * M_PI * n / SKIM_FFT);
+        for(b = 1, k->rev[n] = 0; b < SKIM_HALF; b <<= 1)
+            k->rev[n] = (k->rev[n] << 1) | !!(n & b);
+    }
+    s->l1.skimmer = k;
+}
+
+static void skim_demod(struct demod_state * restrict const s,
+                       const buffer_t buffer, const int length)
+{
+    struct cw_skimmer *k = s->l1.skimmer;
+    int p;
+
+    for(p = k->phase; p < length; p += SKIM_HOP)
+        skim_frame(k, buffer.fbuffer + p);
+    k->phase = p - length;
+}
+
+static void skim_deinit(struct demod_state * const restrict s)
+{
+    struct cw_skimmer *k = s->l1.skimmer;
+    int i;
+
+    for(i = 0; i < SKIM_CHANNELS; i++)
+        if(k->ch[i].bin)
+            skim_flush(&k->ch[i]);
+    verbprintf(1, "CW skimmer: %u channels opened\n", k->opened);
+    free(k);
+}
+
+const struct demod_param demod_morse_skimmer = {
+    "MORSE_SKIMMER", true, FREQ_SAMP, SKIM_FFT, skim_init, skim_demod, skim_deinit
+};
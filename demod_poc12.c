@@ -46,6 +46,7 @@
 static void poc12_init(struct demod_state *s)
 {
 	pocsag_init(s);
+	rxbits_init(s, pocsag_rxbits, BITDUMP_POCSAG);
 	memset(&s->l1.poc12, 0, sizeof(s->l1.poc12));
 }
 
@@ -53,6 +54,8 @@ static void poc12_init(struct demod_state *s)
 
 static void poc12_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
+
 	if (s->l1.poc12.subsamp) {
 		int numfill = SUBSAMP - s->l1.poc12.subsamp;
 		if (length < numfill) {
@@ -79,10 +82,11 @@ static void poc12_demod(struct demod_state *s, buffer_t buffer, int length)
 		s->l1.poc12.sphase += SPHASEINC;
 		if (s->l1.poc12.sphase >= 0x10000u) {
 			s->l1.poc12.sphase &= 0xffffu;
-			pocsag_rxbit(s, s->l1.poc12.dcd_shreg & 1);
+			rxbits_put(s, s->l1.poc12.dcd_shreg & 1, buffer.fbuffer - start);
 		}
 	}
 	s->l1.poc12.subsamp = length;
+	rxbits_flush(s);
 }
 
 static void poc12_deinit(struct demod_state *s)
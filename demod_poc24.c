@@ -43,6 +43,7 @@
 static void poc24_init(struct demod_state *s)
 {
 	pocsag_init(s);
+	rxbits_init(s, pocsag_rxbits, BITDUMP_POCSAG);
 	memset(&s->l1.poc24, 0, sizeof(s->l1.poc24));
 }
 
@@ -50,6 +51,7 @@ static void poc24_init(struct demod_state *s)
 
 static void poc24_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
 	for (; length > 0; length--, buffer.fbuffer++) {
 		s->l1.poc24.dcd_shreg <<= 1;
 		s->l1.poc24.dcd_shreg |= ((*buffer.fbuffer) > 0);
@@ -66,9 +68,10 @@ static void poc24_demod(struct demod_state *s, buffer_t buffer, int length)
 		s->l1.poc24.sphase += SPHASEINC;
 		if (s->l1.poc24.sphase >= 0x10000u) {
 			s->l1.poc24.sphase &= 0xffffu;
-			pocsag_rxbit(s, s->l1.poc24.dcd_shreg & 1);
+			rxbits_put(s, s->l1.poc24.dcd_shreg & 1, buffer.fbuffer - start);
 		}
 	}
+	rxbits_flush(s);
 }
 
 static void poc24_deinit(struct demod_state *s)
@@ -44,6 +44,7 @@
 static void poc5_init(struct demod_state *s)
 {
 	pocsag_init(s);
+	rxbits_init(s, pocsag_rxbits, BITDUMP_POCSAG);
 	memset(&s->l1.poc5, 0, sizeof(s->l1.poc5));
 }
 
@@ -51,6 +52,8 @@ static void poc5_init(struct demod_state *s)
 
 static void poc5_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
+
 	if (s->l1.poc5.subsamp) {
 		int numfill = SUBSAMP - s->l1.poc5.subsamp;
 		if (length < numfill) {
@@ -77,10 +80,11 @@ static void poc5_demod(struct demod_state *s, buffer_t buffer, int length)
 		s->l1.poc5.sphase += SPHASEINC;
 		if (s->l1.poc5.sphase >= 0x10000u) {
 			s->l1.poc5.sphase &= 0xffffu;
-			pocsag_rxbit(s, s->l1.poc5.dcd_shreg & 1);
+			rxbits_put(s, s->l1.poc5.dcd_shreg & 1, buffer.fbuffer - start);
 		}
 	}
 	s->l1.poc5.subsamp = length;
+	rxbits_flush(s);
 }
 
 static void poc5_deinit(struct demod_state *s)
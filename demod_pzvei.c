@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int pzvei_freq[16] = {
-    PHINC(2400), PHINC(1060), PHINC(1160), PHINC(1270),
-    PHINC(1400), PHINC(1530), PHINC(1670), PHINC(1830),
-    PHINC(2000), PHINC(2200), PHINC(970), PHINC(810),
-    PHINC(2800), PHINC(885), PHINC(2400), PHINC(680)
+    2400, 1060, 1160, 1270,
+    1400, 1530, 1670, 1830,
+    2000, 2200, 970, 810,
+    2800, 885, 2400, 680
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void pzvei_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, pzvei_freq);
 }
 
 static void pzvei_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void pzvei_deinit(struct demod_state *s)
 
 static void pzvei_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, pzvei_freq, demod_pzvei.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_pzvei.name);
 }
 
 const struct demod_param demod_pzvei = {
-    "PZVEI", true, SAMPLE_RATE, 0, pzvei_init, pzvei_demod, pzvei_deinit
+    "PZVEI", true, SAMPLE_RATE, SELCALL_OVERLAP, pzvei_init, pzvei_demod, pzvei_deinit
 };
 
 
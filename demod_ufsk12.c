@@ -57,6 +57,7 @@ static void ufsk12_init(struct demod_state *s)
 	int i;
 
 	uart_init(s);
+	rxbits_init(s, uart_rxbits, BITDUMP_UART);
 	memset(&s->l1.ufsk12, 0, sizeof(s->l1.ufsk12));
 	for (f = 0, i = 0; i < CORRLEN; i++) {
 		corr_mark_i[i] = cos(f);
@@ -74,6 +75,7 @@ static void ufsk12_init(struct demod_state *s)
 
 static void ufsk12_demod(struct demod_state *s, buffer_t buffer, int length)
 {
+	const float *start = buffer.fbuffer;
 	float f;
 	unsigned char curbit;
 
@@ -108,11 +110,11 @@ static void ufsk12_demod(struct demod_state *s, buffer_t buffer, int length)
 		if (s->l1.ufsk12.sphase >= 0x10000u) {
 			s->l1.ufsk12.sphase &= 0xffffu;
 			curbit = s->l1.ufsk12.dcd_shreg & 1;
-			verbprintf(9, " %c ", '0'+curbit);
-			uart_rxbit(s, curbit);
+			rxbits_put(s, curbit, buffer.fbuffer - start);
 		}
 	}
 	s->l1.ufsk12.subsamp = length;
+	rxbits_flush(s);
 }
 
 /* ---------------------------------------------------------------------- */
@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int zvei1_freq[16] = {
-    PHINC(2400), PHINC(1060), PHINC(1160), PHINC(1270),
-    PHINC(1400), PHINC(1530), PHINC(1670), PHINC(1830),
-    PHINC(2000), PHINC(2200), PHINC(2800), PHINC(810),
-    PHINC(970), PHINC(885), PHINC(2600), PHINC(680)
+    2400, 1060, 1160, 1270,
+    1400, 1530, 1670, 1830,
+    2000, 2200, 2800, 810,
+    970, 885, 2600, 680
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void zvei1_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, zvei1_freq);
 }
 
 static void zvei1_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void zvei1_deinit(struct demod_state *s)
 
 static void zvei1_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, zvei1_freq, demod_zvei1.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_zvei1.name);
 }
 
 const struct demod_param demod_zvei1 = {
-    "ZVEI1", true, SAMPLE_RATE, 0, zvei1_init, zvei1_demod, zvei1_deinit
+    "ZVEI1", true, SAMPLE_RATE, SELCALL_OVERLAP, zvei1_init, zvei1_demod, zvei1_deinit
 };
 
 
@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int zvei2_freq[16] = {
-    PHINC(2400), PHINC(1060), PHINC(1160), PHINC(1270),
-    PHINC(1400), PHINC(1530), PHINC(1670), PHINC(1830),
-    PHINC(2000), PHINC(2200), PHINC(885), PHINC(825),
-    PHINC(740), PHINC(680), PHINC(970), PHINC(2600)
+    2400, 1060, 1160, 1270,
+    1400, 1530, 1670, 1830,
+    2000, 2200, 885, 825,
+    740, 680, 970, 2600
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void zvei2_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, zvei2_freq);
 }
 
 static void zvei2_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void zvei2_deinit(struct demod_state *s)
 
 static void zvei2_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, zvei2_freq, demod_zvei2.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_zvei2.name);
 }
 
 const struct demod_param demod_zvei2 = {
-    "ZVEI2", true, SAMPLE_RATE, 0, zvei2_init, zvei2_demod, zvei2_deinit
+    "ZVEI2", true, SAMPLE_RATE, SELCALL_OVERLAP, zvei2_init, zvei2_demod, zvei2_deinit
 };
 
 
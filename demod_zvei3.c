@@ -20,22 +20,21 @@
  */
 
 #define SAMPLE_RATE 22050
-#define PHINC(x) ((x)*0x10000/SAMPLE_RATE)
 
 #include "multimon.h"
 
 static const unsigned int zvei3_freq[16] = {
-    PHINC(2400), PHINC(1060), PHINC(1160), PHINC(1270),
-    PHINC(1400), PHINC(1530), PHINC(1670), PHINC(1830),
-    PHINC(2000), PHINC(2200), PHINC(885), PHINC(810),
-    PHINC(2800), PHINC(680), PHINC(970), PHINC(2600)
+    2400, 1060, 1160, 1270,
+    1400, 1530, 1670, 1830,
+    2000, 2200, 885, 810,
+    2800, 680, 970, 2600
 };
 
 /* ---------------------------------------------------------------------- */
 
 static void zvei3_init(struct demod_state *s)
 {
-    selcall_init(s);
+    selcall_init(s, zvei3_freq);
 }
 
 static void zvei3_deinit(struct demod_state *s)
@@ -45,11 +44,11 @@ static void zvei3_deinit(struct demod_state *s)
 
 static void zvei3_demod(struct demod_state *s, buffer_t buffer, int length)
 {
-    selcall_demod(s, buffer.fbuffer, length, zvei3_freq, demod_zvei3.name);
+    selcall_demod(s, buffer.fbuffer, length, demod_zvei3.name);
 }
 
 const struct demod_param demod_zvei3 = {
-    "ZVEI3", true, SAMPLE_RATE, 0, zvei3_init, zvei3_demod, zvei3_deinit
+    "ZVEI3", true, SAMPLE_RATE, SELCALL_OVERLAP, zvei3_init, zvei3_demod, zvei3_deinit
 };
 
 
@@ -122,5 +122,27 @@ static inline float fsqr(float f)
         return f*f;
 }
 
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Float vectors for filters that run several tones, bands or channels side
+ * by side. With GCC and clang they are vector types, which compile to
+ * SSE/AVX/NEON as the target has it; HAVE_VECTORS is then defined. Other
+ * compilers get plain arrays, which only LANE() can reach, and the code
+ * using them needs a scalar loop for that case.
+ */
+#if defined(__GNUC__)
+#define HAVE_VECTORS
+typedef float v8sf __attribute__((vector_size(8 * sizeof(float))));
+typedef float v4sf __attribute__((vector_size(4 * sizeof(float))));
+#define SPLAT8(x)    ((v8sf){} + (x))
+#define SPLAT4(x)    ((v4sf){} + (x))
+#define LANE(v, l)   ((v)[l])
+#else
+typedef struct { float f[8]; } v8sf;
+typedef struct { float f[4]; } v4sf;
+#define LANE(v, l)   ((v).f[l])
+#endif
+
 /* ---------------------------------------------------------------------- */
 #endif /* _FILTER_H */
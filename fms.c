@@ -323,7 +323,7 @@ void fms_init(struct demod_state *s)
 
 /* ---------------------------------------------------------------------- */
 
-void fms_rxbit(struct demod_state *s, int bit)
+static void fms_bit(struct demod_state *s, int bit)
 {
     uint64_t msg;
     int i;
@@ -383,4 +383,18 @@ void fms_rxbit(struct demod_state *s, int bit)
     }
 }
 
+void fms_rxbit(struct demod_state *s, int bit)
+{
+    bitdump_rx(s, BITDUMP_FMS, bit);
+    fms_bit(s, bit);
+}
+
+void fms_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits)
+{
+    unsigned int i;
+
+    for (i = 0; i < nbits; i++)
+        fms_bit(s, rxbits_bit(bits, i));
+}
+
 /* ---------------------------------------------------------------------- */
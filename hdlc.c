@@ -68,18 +68,24 @@ static const unsigned short crc_ccitt_table[] = {
 
 /* ---------------------------------------------------------------------- */
 
-static inline int check_crc_ccitt(const unsigned char *buf, int cnt)
-{
-        unsigned int crc = 0xffff;
+/*
+ * The CRC is kept up to date as the bytes of a frame come in, a frame
+ * including its FCS leaves this residue
+ */
+#define CRC_CCITT_GOOD 0xf0b8
 
-        for (; cnt > 0; cnt--)
-                crc = (crc >> 8) ^ crc_ccitt_table[(crc ^ *buf++) & 0xff];
-        return (crc & 0xffff) == 0xf0b8;
+/* two addresses, the control field and the FCS */
+#define KISS_MIN_FRAME (14 + 1 + 2)
+
+static inline unsigned int crc_ccitt_byte(unsigned int crc, unsigned char c)
+{
+	return (crc >> 8) ^ crc_ccitt_table[(crc ^ c) & 0xff];
 }
 
 /* ---------------------------------------------------------------------- */
 
 int aprs_mode = 0;
+unsigned int hdlc_fix_max = 0;
 
 static void aprs_print_ax25call(unsigned char *call, int is_repeater)
 {
@@ -144,10 +150,6 @@ static void ax25_disp_packet(struct demod_state *s, unsigned char *bp, unsigned
 
         if (!bp || len < 10) 
 		return;
-#if 1
-	if (!check_crc_ccitt(bp, len))
-		return;
-#endif
 	len -= 2;
         if (bp[1] & 1) {
                 /*
@@ -300,46 +302,258 @@ static void ax25_disp_packet(struct demod_state *s, unsigned char *bp, unsigned
 
 /* ---------------------------------------------------------------------- */
 
+/*
+ * The deframer only needs to remember how many ones it saw last, 7 standing
+ * for 7 or more:
+ *   0 after exactly 6 ones     flag, ends the frame and starts a new one
+ *   1 making it 7 ones         abort, out of frame until the next flag
+ *   0 after 5 ones             stuffed bit, dropped
+ * Every other bit is a data bit while in a frame, and is assembled LSB
+ * first. hdlc_rxbits() looks up 8 bits at a time in hdlc_table, by that
+ * count and the bits: the data bits they carry, LSB first, how many, and
+ * the new count. Bytes with a flag or an abort in them take the per bit
+ * path, which is rare outside of preambles.
+ */
+#define TAB_DATA(e)   ((e) & 0xff)
+#define TAB_CNT(e)    (((e) >> 8) & 0xf)
+#define TAB_RUN(e)    (((e) >> 12) & 7)
+#define TAB_EVENT     0x8000
+
+static uint16_t hdlc_table[8][256];
+
+/*
+ * The CRC is linear: flipping a bit changes the residue by the CRC (from
+ * zero) of a lone one bit followed by as many bits as came after it. That
+ * only depends on how far from the end of the frame the bit is, so
+ * crc_flip[] holds it for bit b of the byte n bytes from the end at n*8+b.
+ */
+static uint16_t crc_flip[512*8];       /* one per bit of rxbuf */
+
+static void hdlc_mktable(void)
+{
+	unsigned int run, byte, i, r, data, cnt, ev;
+
+	for (i = 0; i < 8; i++)
+		crc_flip[i] = crc_ccitt_byte(0, 1 << i);
+	for (i = 8; i < sizeof(crc_flip)/sizeof(crc_flip[0]); i++)
+		crc_flip[i] = crc_ccitt_byte(crc_flip[i-8], 0);
+
+	for (run = 0; run < 8; run++)
+		for (byte = 0; byte < 256; byte++) {
+			r = run;
+			data = cnt = ev = 0;
+			for (i = 0; i < 8; i++) {
+				if (byte & (0x80 >> i)) {
+					if (++r >= 7) {
+						r = 7;
+						ev = TAB_EVENT;
+					} else
+						data |= 1 << cnt++;
+				} else {
+					if (r == 6)
+						ev = TAB_EVENT;
+					else if (r != 5 && r != 7)
+						cnt++;
+					r = 0;
+				}
+			}
+			hdlc_table[run][byte] = ev | (r << 12) | (cnt << 8) | data;
+		}
+}
+
 void hdlc_init(struct demod_state *s)
 {
+	if (!hdlc_table[1][0])
+		hdlc_mktable();
 	memset(&s->l2.hdlc, 0, sizeof(s->l2.hdlc));
+#ifdef KISS_OUTPUT
+	if (kiss_enabled)
+		s->l2.hdlc.kiss_port = kiss_port(s->dem_par);
+#endif
+}
+
+void hdlc_deinit(struct demod_state *s)
+{
+	if (hdlc_fix_max)
+		verbprintf(1, "%s: %u frames recovered by flipping bits\n",
+			   s->dem_par->name, s->l2.hdlc.rxfixed);
 }
 
 /* ---------------------------------------------------------------------- */
 
-void hdlc_rxbit(struct demod_state *s, int bit)
+/*
+ * Frames failing their CRC get a second chance when hdlc_fix_max is set:
+ * every single bit, and then every pair of adjacent bits (what one bad bit
+ * on the air turns into after NRZI decoding) is tried until the residue
+ * comes out right, at most hdlc_fix_max of them. Each try is a lookup in
+ * crc_flip[], the frame is only touched once one fits. Recovered frames
+ * must also have a sane AX.25 address field, a 16 bit CRC is not much to
+ * go on after a few thousand tries.
+ */
+
+/* bit t of the frame in the order received, LSB first */
+#define FLIP(len, t)  crc_flip[((len) - 1 - (t) / 8) * 8 + (t) % 8]
+
+static int ax25_plausible(const unsigned char *bp, unsigned int len)
 {
-	s->l2.hdlc.rxbitstream <<= 1;
-	s->l2.hdlc.rxbitstream |= !!bit;
-	if ((s->l2.hdlc.rxbitstream & 0xff) == 0x7e) {
-		if (s->l2.hdlc.rxstate && (s->l2.hdlc.rxptr - s->l2.hdlc.rxbuf) > 2)
-			ax25_disp_packet(s, s->l2.hdlc.rxbuf, s->l2.hdlc.rxptr - s->l2.hdlc.rxbuf);
-		s->l2.hdlc.rxstate = 1;
-		s->l2.hdlc.rxptr = s->l2.hdlc.rxbuf;
-		s->l2.hdlc.rxbitbuf = 0x80;
-		return;
+	unsigned int i, n;
+
+	/* up to 8 repeaters after destination and source, then control */
+	for (n = 0; n < 10; n++, bp += 7, len -= 7) {
+		if (len < 7 + 1 + 2)
+			return 0;
+		for (i = 0; i < 6; i++)
+			if ((bp[i] & 1) || !((bp[i] >= 'A' << 1 && bp[i] <= 'Z' << 1) ||
+					     (bp[i] >= '0' << 1 && bp[i] <= '9' << 1) ||
+					     bp[i] == ' ' << 1))
+				return 0;
+		if (bp[6] & 1)
+			return n >= 1;
 	}
-	if ((s->l2.hdlc.rxbitstream & 0x7f) == 0x7f) {
+	return 0;
+}
+
+static int hdlc_fix(struct demod_state *s, unsigned int len)
+{
+	unsigned char *bp = s->l2.hdlc.rxbuf;
+	unsigned int syn = s->l2.hdlc.rxcrc ^ CRC_CCITT_GOOD;
+	unsigned int nbits = len * 8, tries = hdlc_fix_max, t, w;
+
+	for (w = 1; w <= 2; w++)
+		for (t = 0; t + w <= nbits; t++) {
+			if (!tries--)
+				return 0;
+			if ((FLIP(len, t) ^ (w == 2 ? FLIP(len, t + 1) : 0)) != syn)
+				continue;
+			bp[t / 8] ^= 1 << (t % 8);
+			if (w == 2)
+				bp[(t + 1) / 8] ^= 1 << ((t + 1) % 8);
+			if (ax25_plausible(bp, len)) {
+				verbprintf(2, "%s: frame recovered by flipping bit %u%s\n",
+					   s->dem_par->name, t, w == 2 ? " and the next" : "");
+				s->l2.hdlc.rxfixed++;
+				return 1;
+			}
+			bp[t / 8] ^= 1 << (t % 8);
+			if (w == 2)
+				bp[(t + 1) / 8] ^= 1 << ((t + 1) % 8);
+		}
+	return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static int hdlc_repeat(struct hdlc_dedup *d, const unsigned char *bp, unsigned int len)
+{
+	uint32_t hash = 2166136261u;	/* FNV-1a */
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ bp[i]) * 16777619u;
+	for (i = 0; i < HDLC_DEDUP_SLOTS; i++)
+		if (d->seen[i].hash == hash && d->now - d->seen[i].when <= d->window) {
+			d->repeats++;
+			return 1;
+		}
+	d->seen[d->next].hash = hash;
+	d->seen[d->next].when = d->now;
+	d->next = (d->next + 1) % HDLC_DEDUP_SLOTS;
+	d->frames++;
+	return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static inline void hdlc_rxbyte(struct demod_state *s, unsigned char c)
+{
+	if (s->l2.hdlc.rxptr >= s->l2.hdlc.rxbuf+sizeof(s->l2.hdlc.rxbuf)) {
 		s->l2.hdlc.rxstate = 0;
+		verbprintf(1, "Error: packet size too large\n");
 		return;
 	}
-	if (!s->l2.hdlc.rxstate)
-		return;
-	if ((s->l2.hdlc.rxbitstream & 0x3f) == 0x3e) /* stuffed bit */
-		return;
-	if (s->l2.hdlc.rxbitstream & 1)
-		s->l2.hdlc.rxbitbuf |= 0x100;
-	if (s->l2.hdlc.rxbitbuf & 1) {
-		if (s->l2.hdlc.rxptr >= s->l2.hdlc.rxbuf+sizeof(s->l2.hdlc.rxbuf)) {
+	*s->l2.hdlc.rxptr++ = c;
+	s->l2.hdlc.rxcrc = crc_ccitt_byte(s->l2.hdlc.rxcrc, c);
+}
+
+static void hdlc_bit(struct demod_state *s, int bit)
+{
+	if (bit) {
+		if (++s->l2.hdlc.rxrun >= 7) {
+			s->l2.hdlc.rxrun = 7;
 			s->l2.hdlc.rxstate = 0;
-			verbprintf(1, "Error: packet size too large\n");
 			return;
 		}
-		*s->l2.hdlc.rxptr++ = s->l2.hdlc.rxbitbuf >> 1;
-		s->l2.hdlc.rxbitbuf = 0x80;
+	} else {
+		unsigned int run = s->l2.hdlc.rxrun;
+
+		s->l2.hdlc.rxrun = 0;
+		if (run == 6) {
+			unsigned int len = s->l2.hdlc.rxptr - s->l2.hdlc.rxbuf;
+
+			if (s->l2.hdlc.rxstate && len > 2 && (s->l2.hdlc.rxcrc == CRC_CCITT_GOOD ||
+							      (hdlc_fix_max && hdlc_fix(s, len))) &&
+			    !(s->l2.hdlc.dedup && hdlc_repeat(s->l2.hdlc.dedup, s->l2.hdlc.rxbuf, len))) {
+#ifdef KISS_OUTPUT
+				/* the frame as received, without its FCS */
+				if (kiss_enabled) {
+					/* anything shorter is noise that happened to pass the CRC */
+					if (len >= KISS_MIN_FRAME)
+						kiss_frame(s->l2.hdlc.kiss_port, s->l2.hdlc.rxbuf, len - 2);
+				} else
+#endif
+				ax25_disp_packet(s, s->l2.hdlc.rxbuf, len);
+			}
+			s->l2.hdlc.rxstate = 1;
+			s->l2.hdlc.rxptr = s->l2.hdlc.rxbuf;
+			s->l2.hdlc.rxacc = s->l2.hdlc.rxnacc = 0;
+			s->l2.hdlc.rxcrc = 0xffff;
+			return;
+		}
+		if (run >= 5)
+			return;		/* stuffed bit, or still aborted */
+	}
+	if (!s->l2.hdlc.rxstate)
 		return;
+	s->l2.hdlc.rxacc |= (unsigned int)!!bit << s->l2.hdlc.rxnacc;
+	if (++s->l2.hdlc.rxnacc == 8) {
+		hdlc_rxbyte(s, s->l2.hdlc.rxacc);
+		s->l2.hdlc.rxacc = s->l2.hdlc.rxnacc = 0;
+	}
+}
+
+void hdlc_rxbit(struct demod_state *s, int bit)
+{
+	bitdump_rx(s, BITDUMP_HDLC, bit);
+	hdlc_bit(s, bit);
+}
+
+/*
+ * nbits bits, packed MSB first: the first bit received is bit 7 of bits[0]
+ */
+void hdlc_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits)
+{
+	unsigned int i, e;
+
+	for (; nbits >= 8; nbits -= 8, bits++) {
+		e = hdlc_table[s->l2.hdlc.rxrun][*bits];
+		if (e & TAB_EVENT) {
+			for (i = 0; i < 8; i++)
+				hdlc_bit(s, (*bits >> (7 - i)) & 1);
+			continue;
+		}
+		s->l2.hdlc.rxrun = TAB_RUN(e);
+		if (!s->l2.hdlc.rxstate)
+			continue;
+		s->l2.hdlc.rxacc |= TAB_DATA(e) << s->l2.hdlc.rxnacc;
+		s->l2.hdlc.rxnacc += TAB_CNT(e);
+		if (s->l2.hdlc.rxnacc >= 8) {
+			hdlc_rxbyte(s, s->l2.hdlc.rxacc);
+			s->l2.hdlc.rxacc >>= 8;
+			s->l2.hdlc.rxnacc -= 8;
+		}
 	}
-      	s->l2.hdlc.rxbitbuf >>= 1;
+	for (i = 0; i < nbits; i++)
+		hdlc_bit(s, rxbits_bit(bits, i));
 }
 
 /* ---------------------------------------------------------------------- */
@@ -0,0 +1,174 @@
+/*
+ *      ingest.c -- sample ingestion shared by all input paths
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include "multimon.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Time constant of the optional DC blocker. The offset is estimated once
+ * per block from the block mean, so the correction itself stays a single
+ * vectorised subtraction.
+ */
+#define DC_TAU 0.1f
+
+float ingest_gain = 1.0f;
+bool ingest_dc_block = false;
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * out[i] = in[i] * scale - offset
+ */
+static void convert_s16(float *out, const short *in, unsigned int n,
+			float scale, float offset)
+{
+	unsigned int i = 0;
+
+#if defined(__AVX2__)
+	const __m256 vs = _mm256_set1_ps(scale);
+	const __m256 vo = _mm256_set1_ps(offset);
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		__m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x));
+		_mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_mul_ps(f, vs), vo));
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	const __m128 vs = _mm_set1_ps(scale);
+	const __m128 vo = _mm_set1_ps(offset);
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		/* sign extend by interleaving with itself and shifting back */
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(out + i, _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), vs), vo));
+		_mm_storeu_ps(out + i + 4, _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), vs), vo));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	const float32x4_t vs = vdupq_n_f32(scale);
+	const float32x4_t vo = vdupq_n_f32(offset);
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t x = vld1q_s16(in + i);
+		float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+		float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+		vst1q_f32(out + i, vsubq_f32(vmulq_f32(lo, vs), vo));
+		vst1q_f32(out + i + 4, vsubq_f32(vmulq_f32(hi, vs), vo));
+	}
+#endif
+	for (; i < n; i++)
+		out[i] = in[i] * scale - offset;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static float block_mean(const short *in, unsigned int n)
+{
+	int64_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		sum += in[i];
+	return n ? (float)sum / n : 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ingest_init(struct sample_ingest *in, unsigned int sample_rate,
+		 unsigned int overlap, bool float_view)
+{
+	memset(in, 0, sizeof(*in));
+	in->sample_rate = sample_rate;
+	in->overlap = overlap;
+	in->float_view = float_view;
+	in->scale = ingest_gain * (1.0f/32768.0f);
+	in->dc_block = ingest_dc_block;
+}
+
+/* ---------------------------------------------------------------------- */
+
+short *ingest_buffer(struct sample_ingest *in, unsigned int *space)
+{
+	*space = INGEST_BUFLEN - in->cnt;
+	if (*space > INGEST_CHUNK)
+		*space = INGEST_CHUNK;
+	return in->sbuf + in->cnt;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ingest_commit(struct sample_ingest *in, unsigned int n)
+{
+	unsigned int len;
+
+	if (!n)
+		return;
+	if (in->float_view) {
+		if (in->dc_block) {
+			float k = n / (DC_TAU * in->sample_rate);
+			if (k > 1)
+				k = 1;
+			in->dc += (block_mean(in->sbuf + in->cnt, n) - in->dc) * k;
+		}
+		convert_s16(in->fbuf + in->cnt, in->sbuf + in->cnt, n,
+			    in->scale, in->dc * in->scale);
+	}
+	in->cnt += n;
+	if (in->cnt <= in->overlap)
+		return;
+	/*
+	 * both views carry the same overlap so that sbuffer[i] and
+	 * fbuffer[i] always refer to the same sample
+	 */
+	len = in->cnt - in->overlap;
+	process_buffer(in->fbuf, in->sbuf, len);
+	memmove(in->sbuf, in->sbuf + len, in->overlap * sizeof(in->sbuf[0]));
+	if (in->float_view)
+		memmove(in->fbuf, in->fbuf + len, in->overlap * sizeof(in->fbuf[0]));
+	in->cnt = in->overlap;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void ingest_samples(struct sample_ingest *in, const short *src, unsigned int n)
+{
+	unsigned int space;
+	short *dst;
+
+	while (n > 0) {
+		dst = ingest_buffer(in, &space);
+		if (space > n)
+			space = n;
+		memcpy(dst, src, space * sizeof(src[0]));
+		ingest_commit(in, space);
+		src += space;
+		n -= space;
+	}
+}
+
+/* ---------------------------------------------------------------------- */
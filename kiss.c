@@ -0,0 +1,313 @@
+/*
+ *      kiss.c -- KISS TNC output of the AX.25 frames hdlc.c receives
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* posix_openpt(), cfmakeraw() */
+#endif
+
+#include "multimon.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Frames go out as KISS data frames, one KISS port per demodulator in the
+ * order they are enabled, either on a pseudo terminal or to every client
+ * of a TCP listener. Nothing here ever blocks: each client has a queue,
+ * what the client does not take right away waits there, and frames that
+ * no longer fit are dropped for that client only.
+ */
+
+#define FEND          0xc0
+#define FESC          0xdb
+#define TFEND         0xdc
+#define TFESC         0xdd
+
+#define KISS_CLIENTS  8
+#define KISS_QUEUE    65536
+#define KISS_PORTS    16
+#define KISS_LINGER   1000      /* ms spent handing over queued frames on exit */
+
+bool kiss_enabled = false;
+
+static int listen_fd = -1;
+static bool is_pty;
+static unsigned int nports;
+static const struct demod_param *ports[KISS_PORTS];
+static unsigned long long nframes, ndropped;
+
+static struct client {
+    int fd;
+    unsigned int len;
+    unsigned char q[KISS_QUEUE];
+} clients[KISS_CLIENTS];
+
+static void nonblock(int fd)
+{
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK)) {
+        perror("kiss: fcntl");
+        exit(10);
+    }
+}
+
+static void open_pty(void)
+{
+    struct termios tio;
+    int fd;
+
+    if ((fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(fd) || unlockpt(fd)) {
+        perror("kiss: pty");
+        exit(10);
+    }
+    /* frames are binary, the line discipline must not touch them */
+    if (!tcgetattr(fd, &tio)) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    nonblock(fd);
+    is_pty = true;
+    clients[0].fd = fd;
+    fprintf(stderr, "KISS: pty %s\n", ptsname(fd));
+}
+
+static void open_listener(const char *addr)
+{
+    struct addrinfo hints, *res, *ai;
+    char host[256];
+    const char *port = addr;
+    const char *colon = strrchr(addr, ':');
+    int err, one = 1;
+
+    /* only local clients unless a host to listen on is given */
+    strcpy(host, "localhost");
+    if (colon) {
+        if ((size_t)(colon - addr) >= sizeof(host)) {
+            fprintf(stderr, "kiss: address too long: %s\n", addr);
+            exit(10);
+        }
+        memcpy(host, addr, colon - addr);
+        host[colon - addr] = 0;
+        port = colon + 1;
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if ((err = getaddrinfo(host[0] ? host : NULL, port, &hints, &res))) {
+        fprintf(stderr, "kiss: %s: %s\n", addr, gai_strerror(err));
+        exit(10);
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((listen_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (!bind(listen_fd, ai->ai_addr, ai->ai_addrlen) && !listen(listen_fd, KISS_CLIENTS))
+            break;
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    freeaddrinfo(res);
+    if (listen_fd < 0) {
+        perror("kiss: bind");
+        exit(10);
+    }
+    nonblock(listen_fd);
+}
+
+/*
+ * spec is "pty" or [host:]port
+ */
+void kiss_open(const char *spec)
+{
+    unsigned int i;
+
+    for (i = 0; i < KISS_CLIENTS; i++)
+        clients[i].fd = -1;
+    if (!strcmp(spec, "pty"))
+        open_pty();
+    else
+        open_listener(spec);
+    kiss_enabled = true;
+}
+
+/*
+ * The KISS port of a demodulator, the parallel slicers of one demodulator
+ * share theirs
+ */
+unsigned int kiss_port(const struct demod_param *dem_par)
+{
+    unsigned int i;
+
+    for (i = 0; i < nports; i++)
+        if (ports[i] == dem_par)
+            return i;
+    if (nports >= KISS_PORTS) {
+        fprintf(stderr, "kiss: more than %d demodulators\n", KISS_PORTS);
+        exit(2);
+    }
+    ports[nports] = dem_par;
+    return nports++;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void drop_client(struct client *c)
+{
+    verbprintf(1, "KISS: client %d gone\n", c->fd);
+    close(c->fd);
+    c->fd = -1;
+    c->len = 0;
+}
+
+static void client_flush(struct client *c)
+{
+    ssize_t n;
+
+    while (c->len) {
+        if (is_pty)
+            n = write(c->fd, c->q, c->len);
+        else
+            n = send(c->fd, c->q, c->len, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->len -= n;
+            memmove(c->q, c->q + n, c->len);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+        if (is_pty) {
+            c->len = 0;         /* EIO: nothing has the other side open */
+            return;
+        }
+        drop_client(c);
+        return;
+    }
+}
+
+/*
+ * Called once per block of samples: takes on new clients, throws away what
+ * they send (there is no transmitter) and hands over queued frames.
+ */
+void kiss_poll(void)
+{
+    unsigned char buf[512];
+    struct client *c;
+    unsigned int i;
+    ssize_t n;
+    int fd;
+
+    while (listen_fd >= 0 && (fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        for (i = 0; i < KISS_CLIENTS && clients[i].fd >= 0; i++);
+        if (i == KISS_CLIENTS) {
+            verbprintf(1, "KISS: too many clients\n");
+            close(fd);
+            continue;
+        }
+        nonblock(fd);
+        clients[i].fd = fd;
+        clients[i].len = 0;
+        verbprintf(1, "KISS: client %d connected\n", fd);
+    }
+    for (c = clients; c < clients + KISS_CLIENTS; c++) {
+        if (c->fd < 0)
+            continue;
+        while ((n = read(c->fd, buf, sizeof(buf))) > 0);
+        if (!n && !is_pty) {
+            drop_client(c);
+            continue;
+        }
+        client_flush(c);
+    }
+}
+
+void kiss_frame(unsigned int port, const unsigned char *bp, unsigned int len)
+{
+    unsigned char buf[2 + 2 * 512 + 1], *p = buf;
+    struct client *c;
+    unsigned int i;
+
+    if (len > 512)
+        return;
+    *p++ = FEND;
+    *p++ = port << 4;           /* data frame */
+    for (i = 0; i < len; i++) {
+        if (bp[i] == FEND) {
+            *p++ = FESC;
+            *p++ = TFEND;
+        } else if (bp[i] == FESC) {
+            *p++ = FESC;
+            *p++ = TFESC;
+        } else
+            *p++ = bp[i];
+    }
+    *p++ = FEND;
+    nframes++;
+
+    for (c = clients; c < clients + KISS_CLIENTS; c++) {
+        if (c->fd < 0)
+            continue;
+        if (c->len + (p - buf) > KISS_QUEUE) {
+            ndropped++;
+            continue;
+        }
+        memcpy(c->q + c->len, buf, p - buf);
+        c->len += p - buf;
+        client_flush(c);
+    }
+}
+
+void kiss_close(void)
+{
+    struct pollfd pfd[KISS_CLIENTS];
+    unsigned int i, n;
+    int ms;
+
+    if (!kiss_enabled)
+        return;
+    for (ms = 0; ms < KISS_LINGER; ms += 10) {
+        for (i = n = 0; i < KISS_CLIENTS; i++)
+            if (clients[i].fd >= 0 && clients[i].len) {
+                pfd[n].fd = clients[i].fd;
+                pfd[n++].events = POLLOUT;
+            }
+        if (!n)
+            break;
+        poll(pfd, n, 10);
+        kiss_poll();
+    }
+    for (i = 0; i < KISS_CLIENTS; i++)
+        if (clients[i].fd >= 0)
+            close(clients[i].fd);
+    if (listen_fd >= 0)
+        close(listen_fd);
+    listen_fd = -1;
+    kiss_enabled = false;
+    verbprintf(1, "KISS: %llu frames, %llu dropped for clients falling behind\n",
+               nframes, ndropped);
+}
@@ -4,4 +4,7 @@
 
 #include "win32_getopt.h"
  
-#define strcasecmp(s1, s2) _stricmp(s1, s2)
\ No newline at end of file
+#define strcasecmp(s1, s2) _stricmp(s1, s2)
+/* reentrant time conversion, the FLEX workers format times too */
+#define gmtime_r(t, tm) (gmtime_s((tm), (t)) ? NULL : (tm))
+#define localtime_r(t, tm) (localtime_s((tm), (t)) ? NULL : (tm))
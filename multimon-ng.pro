@@ -15,12 +15,18 @@ INSTALLS += target
 
 HEADERS += \
     multimon.h \
+    shmring.h \
+    netpcm.h \
+    actindex.h \
     gen.h \
     filter.h \
-    filter-i386.h
+    filter-i386.h \
+    BCH3121.h
 
 SOURCES += \
     unixinput.c \
+    ingest.c \
+    bitdump.c \
     uart.c \
     pocsag.c \
     selcall.c \
@@ -40,6 +46,7 @@ SOURCES += \
     demod_hapn48.c \
     demod_fsk96.c \
     demod_dtmf.c \
+    demod_ctcss.c \
     demod_clipfsk.c \
     demod_fmsfsk.c \
     demod_afsk24.c \
@@ -47,7 +54,8 @@ SOURCES += \
     demod_afsk24_2.c \
     demod_afsk12.c \
     demod_flex.c \
-    BCHCode.c \
+    BCH3121.c \
+    BCHCode_stub.c \
     costabi.c \
     costabf.c \
     clip.c \
@@ -57,6 +65,13 @@ SOURCES += \
     demod_dumpcsv.c \
     demod_x10.c
 
+unix{
+DEFINES += FLEX_THREADS
+LIBS += -lpthread
+DEFINES += KISS_OUTPUT
+SOURCES += kiss.c
+}
+
 macx{
 DEFINES += DUMMY_AUDIO
 DEFINES += NO_X11
@@ -31,6 +31,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef _MSC_VER
 #include "msvc_support.h"
@@ -67,6 +68,9 @@ enum EAS_L1_State
     EAS_L1_SYNC = 1,
 };
 
+#define RXBITS_MAX 1024
+#define G3RUH_MAXTAPS 64
+
 struct demod_state {
     const struct demod_param *dem_par;
     union {
@@ -85,6 +89,10 @@ struct demod_state {
             uint8_t  padding;
             uint32_t rxbitstream; // holds RXed bits
             uint32_t rxbitcount; // counts RXed bits
+            uint16_t sync_count; // bit sync alternations so far
+            uint8_t  last_bit;
+            uint32_t rxunits; // BCH units after the length
+            unsigned char rxraw[128 * 26 / 8 + 3]; // and their bits as RXed
         } cirfsk;
 
         struct l2_state_clipfsk {
@@ -107,8 +115,13 @@ struct demod_state {
             unsigned char rxbuf[512];
             unsigned char *rxptr;
             uint32_t rxstate;
-            uint32_t rxbitstream;
-            uint32_t rxbitbuf;
+            uint32_t rxrun;             // ones in a row, 7 for 7 or more
+            uint32_t rxacc;             // data bits of the next byte, LSB first
+            uint32_t rxnacc;
+            uint32_t rxcrc;
+            uint32_t rxfixed;           // frames recovered by flipping bits
+            struct hdlc_dedup *dedup;   // shared by parallel slicers, or NULL
+            uint32_t kiss_port;
         } hdlc;
         
         struct l2_state_eas {
@@ -191,6 +204,7 @@ struct demod_state {
             uint32_t sphase;
             uint32_t lasts;
             uint32_t subsamp;
+            struct afsk12_slicers *slicers;
         } afsk12;
         
         struct l1_state_afsk24 {
@@ -210,22 +224,52 @@ struct demod_state {
             unsigned int sphase;
             unsigned int descram;
         } fsk96;
+
+        struct l1_state_g3ruh {
+            float taps[G3RUH_MAXTAPS];  // receive filter
+            unsigned int ntaps;
+            uint32_t sphase;            // bit clock, a bit is 2^32
+            uint32_t sphaseinc;
+            int32_t freq, freqmax;      // bit rate correction
+            float last;                 // filter output at the previous sample
+            uint64_t line;              // received line bits, newest in bit 0
+        } g3ruh;
         
         struct l1_state_dtmf {
             unsigned int ph[8];
+            float s1[8], s2[8];
             float energy[4];
             float tenergy[4][16];
+            int ring;
             int blkcount;
+            int subsamp;
             int lastch;
         } dtmf;
         
-        struct l1_state_selcall {
-            unsigned int ph[16];
-            float energy[4];
-            float tenergy[4][32];
+        struct l1_state_ctcss {
+            unsigned int ph[50];
+            float s1[56], s2[56];
+            float energy[5];
+            float tenergy[5][100];
+            float delay[2*90];
+            int dlpos;
+            int decim2;
+            int ring;
             int blkcount;
+            int subsamp;
+            int tone, cand;
+            int hits, misses;
+        } ctcss;
+
+        struct l1_state_selcall {
+            struct selcall_engine *eng; /* tone analyzer, see selcall.c */
+            unsigned char tone[16];     /* in the analyzer */
+            unsigned int run;
             int lastch;
             int timeout;
+            int chan;                   /* --channels channel, -1 without */
+            char line[64];              /* the line so far on a channel */
+            unsigned int len, start;
         } selcall;
 
         struct l1_state_morse {
@@ -240,10 +284,17 @@ struct demod_state {
             int_fast32_t decoded_chars;
             int_fast16_t time_unit_dit_dah_samples;
             int_fast16_t time_unit_gaps_samples;
-            int_fast16_t lowpass_strength;
+            int_fast32_t lowpass_coef;  // 16 bit fraction
             int_fast16_t holdoff_samples;
             int_fast8_t current_state;  // High = 1, Low = 0
+            int_fast32_t squelch;       // lowest detection threshold
+            int32_t env_acc;            // partial envelope block
+            int env_cnt;
+            char *text;                 // if set, decoded text goes here
+            unsigned int text_len, text_size;
         } morse;
+
+        struct cw_skimmer *skimmer;
         
         struct l1_state_dumpcsv {
             uint32_t current_sequence;
@@ -269,6 +320,15 @@ struct demod_state {
         } scope;
 #endif
     } l1;
+
+    /* bits on their way from layer 1 to layer 2, see rxbits_put() */
+    struct rxbits {
+        void (*l2)(struct demod_state *s, const unsigned char *bits, unsigned int nbits);
+        unsigned char dump;         // enum bitdump_l2
+        unsigned int n;
+        unsigned char bits[RXBITS_MAX / 8];
+        unsigned short offs[RXBITS_MAX];
+    } rxbits;
 };
 
 typedef struct buffer
@@ -308,8 +368,12 @@ extern const struct demod_param demod_afsk2400_3;
 
 extern const struct demod_param demod_hapn4800;
 extern const struct demod_param demod_fsk9600;
+extern const struct demod_param demod_fsk9600_48;
+extern const struct demod_param demod_fsk19200;
+extern const struct demod_param demod_fsk38400;
 
 extern const struct demod_param demod_dtmf;
+extern const struct demod_param demod_ctcss;
 
 extern const struct demod_param demod_zvei1;
 extern const struct demod_param demod_zvei2;
@@ -321,6 +385,7 @@ extern const struct demod_param demod_eia;
 extern const struct demod_param demod_ccir;
 
 extern const struct demod_param demod_morse;
+extern const struct demod_param demod_morse_skimmer;
 
 extern const struct demod_param demod_x10;
 
@@ -337,8 +402,8 @@ extern const struct demod_param demod_scope;
 
 #define ALL_DEMOD &demod_poc5, &demod_poc12, &demod_poc24, &demod_flex, &demod_eas, &demod_ufsk1200, &demod_clipfsk, &demod_fmsfsk, \
     &demod_afsk1200, &demod_afsk2400, &demod_afsk2400_2, &demod_afsk2400_3, &demod_hapn4800, &demod_cirfsk, \
-    &demod_fsk9600, &demod_dtmf, &demod_zvei1, &demod_zvei2, &demod_zvei3, &demod_dzvei, \
-    &demod_pzvei, &demod_eea, &demod_eia, &demod_ccir, &demod_morse, &demod_dumpcsv, &demod_x10 SCOPE_DEMOD
+    &demod_fsk9600, &demod_fsk9600_48, &demod_fsk19200, &demod_fsk38400, &demod_dtmf, &demod_zvei1, &demod_zvei2, &demod_zvei3, &demod_dzvei, \
+    &demod_pzvei, &demod_eea, &demod_eia, &demod_ccir, &demod_ctcss, &demod_morse, &demod_morse_skimmer, &demod_dumpcsv, &demod_x10 SCOPE_DEMOD
 
 
 /* ---------------------------------------------------------------------- */
@@ -350,29 +415,180 @@ void _verbprintf(int verb_level, const char *fmt, ...);
 #define verbprintf(level, ...) \
     do { if (level <= MAX_VERBOSE_LEVEL) _verbprintf(level, __VA_ARGS__); } while (0)
 
+/*
+ * Decoders running on threads of their own collect their output in a
+ * verb_buffer, the main thread prints it with verb_release().
+ */
+struct verb_buffer {
+    char *buf;
+    size_t len, size;
+};
+
+void verb_capture(struct verb_buffer *vb);
+void verb_release(struct verb_buffer *vb);
+
+
+void process_buffer(float *float_buf, short *short_buf, unsigned int len);
+
+/*
+ * Sample ingestion: keeps the int16 and float views of the input in step
+ * (including the demodulator overlap) and feeds them to process_buffer().
+ * Writers either fill ingest_buffer() in place and ingest_commit() it, or
+ * hand over a block with ingest_samples().
+ */
+#define INGEST_CHUNK  8192
+#define INGEST_BUFLEN (2*INGEST_CHUNK)
+
+struct sample_ingest {
+    unsigned int sample_rate;
+    unsigned int overlap;
+    unsigned int cnt;
+    bool float_view;
+    bool dc_block;
+    float scale;
+    float dc;
+    short sbuf[INGEST_BUFLEN];
+    float fbuf[INGEST_BUFLEN];
+};
+
+extern float ingest_gain;
+extern bool ingest_dc_block;
+
+void ingest_init(struct sample_ingest *in, unsigned int sample_rate,
+                 unsigned int overlap, bool float_view);
+short *ingest_buffer(struct sample_ingest *in, unsigned int *space);
+void ingest_commit(struct sample_ingest *in, unsigned int n);
+void ingest_samples(struct sample_ingest *in, const short *src, unsigned int n);
+
+/*
+ * KISS output of received AX.25 frames, see kiss.c
+ */
+extern bool kiss_enabled;
+
+void kiss_open(const char *spec);
+unsigned int kiss_port(const struct demod_param *dem_par);
+void kiss_frame(unsigned int port, const unsigned char *bp, unsigned int len);
+void kiss_poll(void);
+void kiss_close(void);
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Recording and replay of the bits (FLEX: symbols) the demodulators hand
+ * to their layer 2 decoders, see bitdump.c
+ */
+enum bitdump_l2 {
+    BITDUMP_HDLC = 1, BITDUMP_POCSAG, BITDUMP_UART, BITDUMP_CLIP,
+    BITDUMP_FMS, BITDUMP_CIR, BITDUMP_FLEX
+};
+
+extern bool bitdump_enabled;
+
+void bitdump_open(const char *fname, unsigned int sample_rate);
+void bitdump_put(struct demod_state *s, enum bitdump_l2 l2, unsigned int sym);
+void bitdump_block(unsigned int len);
+void bitdump_close(void);
+void bitdump_replay(const char *fname, struct demod_state *(*find)(const char *name));
+
+static inline void bitdump_rx(struct demod_state *s, enum bitdump_l2 l2, unsigned int sym)
+{
+    if (bitdump_enabled)
+        bitdump_put(s, l2, sym);
+}
+
+void bitdump_putbits(struct demod_state *s, enum bitdump_l2 l2, const unsigned char *bits,
+                     const unsigned short *offs, unsigned int nbits);
+
+/*
+ * Layer 1 hands the bits it recovers from a block of samples to layer 2
+ * in one go: rxbits_put() collects them, packed MSB first, together with
+ * their sample offsets within the block, and rxbits_flush() at the end of
+ * the block (or once RXBITS_MAX bits are waiting) passes them on to the
+ * layer 2 block function given to rxbits_init(), and to --bitdump as
+ * stream dump unless that is 0.
+ */
+void rxbits_init(struct demod_state *s,
+                 void (*l2)(struct demod_state *s, const unsigned char *bits, unsigned int nbits),
+                 enum bitdump_l2 dump);
+void rxbits_flush(struct demod_state *s);
+
+static inline void rxbits_put(struct demod_state *s, unsigned int bit, unsigned int offs)
+{
+    struct rxbits *rb = &s->rxbits;
+
+    if (!(rb->n & 7))
+        rb->bits[rb->n >> 3] = 0;
+    rb->bits[rb->n >> 3] |= (bit & 1) << (7 - (rb->n & 7));
+    rb->offs[rb->n] = offs;
+    if (++rb->n == RXBITS_MAX)
+        rxbits_flush(s);
+}
+
+/* bit i of a packed buffer, for the layer 2 block functions */
+static inline unsigned int rxbits_bit(const unsigned char *bits, unsigned int i)
+{
+    return (bits[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+/*
+ * Frames seen again within window samples are dropped, so that parallel
+ * slicers on one signal only print each frame once
+ */
+#define HDLC_DEDUP_SLOTS 16
+
+struct hdlc_dedup {
+    uint64_t now;                   // samples the demodulator has seen
+    unsigned int window;
+    unsigned int next;
+    unsigned int frames, repeats;
+    struct {
+        uint32_t hash;
+        uint64_t when;
+    } seen[HDLC_DEDUP_SLOTS];
+};
 
 void hdlc_init(struct demod_state *s);
+void hdlc_deinit(struct demod_state *s);
 void hdlc_rxbit(struct demod_state *s, int bit);
+void hdlc_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits);
 
 void uart_init(struct demod_state *s);
 void uart_rxbit(struct demod_state *s, int bit);
+void uart_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits);
 void clip_init(struct demod_state *s);
 void clip_rxbit(struct demod_state *s, int bit);
+void clip_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits);
 
 void fms_init(struct demod_state *s);
 void fms_rxbit(struct demod_state *s, int bit);
+void fms_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits);
 
 void cir_init(struct demod_state *s);
 void cir_rxbit(struct demod_state *s, unsigned char bit);
+void cir_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits);
 
 void pocsag_init(struct demod_state *s);
 void pocsag_rxbit(struct demod_state *s, int32_t bit);
+void pocsag_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits);
 void pocsag_deinit(struct demod_state *s);
 
-void selcall_init(struct demod_state *s);
+void flex_rxsym(struct demod_state *s, unsigned char sym);
+
+/* DTMF and selcall on up to CHANNELS_MAX interleaved channels side by side */
+#define CHANNELS_MAX 16
+
+void dtmf_lanes_init(unsigned int nchan);
+void dtmf_lanes_demod(const short *frames, unsigned int nframes);
+
+#define SELCALL_OVERLAP 32
+
+void selcall_init(struct demod_state *s, const unsigned int *selcall_freq);
 void selcall_demod(struct demod_state *s, const float *buffer, int length,
-                   const unsigned int *selcall_freq, const char *const name);
+                   const char *const name);
 void selcall_deinit(struct demod_state *s);
+void selcall_lanes_init(unsigned int nchan, const struct demod_param *const *std, unsigned int nstd);
+void selcall_lanes_demod(const short *frames, unsigned int nframes);
+void selcall_lanes_deinit(void);
 
 void xdisp_terminate(int cnum);
 int xdisp_start(void);
@@ -0,0 +1,235 @@
+/*
+ *      netfeed.c -- reference sender for multimon-ng's "udp" and "tcp" inputs
+ *
+ *      Sends raw 16 bit samples from a file or standard input over UDP
+ *      (framed as described in netpcm.h) or TCP. Datagrams can be dropped
+ *      or reordered on purpose to exercise the receiver's jitter buffer.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include "netpcm.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* ---------------------------------------------------------------------- */
+
+struct packet {
+	struct netpcm_header hdr;
+	short samples[NETPCM_MAXSAMPLES];
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int connect_to(const char *addr, int socktype)
+{
+	struct addrinfo hints, *res, *ai;
+	char host[256];
+	const char *colon = strrchr(addr, ':');
+	int fd = -1, err;
+
+	if (!colon || (size_t)(colon - addr) >= sizeof(host)) {
+		fprintf(stderr, "invalid address \"%s\", expected host:port\n", addr);
+		exit(2);
+	}
+	memcpy(host, addr, colon - addr);
+	host[colon - addr] = 0;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = socktype;
+	if ((err = getaddrinfo(host, colon + 1, &hints, &res))) {
+		fprintf(stderr, "%s: %s\n", addr, gai_strerror(err));
+		exit(10);
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+			continue;
+		if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0) {
+		perror("connect");
+		exit(10);
+	}
+	return fd;
+}
+
+static void send_packet(int fd, const struct packet *p, size_t len)
+{
+	if (send(fd, p, len, 0) < 0 && errno != ECONNREFUSED) {
+		perror("send");
+		exit(4);
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+
+static const char usage_str[] = "netfeed-ng\n"
+"Sends raw signed 16 bit samples to multimon-ng over UDP or TCP\n"
+"usage: %s [options] host:port [file]\n"
+"  -T         : use TCP instead of UDP\n"
+"  -r <rate>  : sample rate for -R (default: 22050)\n"
+"  -s <n>     : samples per datagram (default: 256, max 2048)\n"
+"  -R         : pace the output in real time\n"
+"  -d <n>     : UDP: drop every n-th datagram\n"
+"  -x <n>     : UDP: send every n-th datagram after its successor\n"
+"  -D <n>     : UDP: send every n-th datagram twice\n"
+"  -h         : this help\n"
+"  Reads standard input if no file is given.\n";
+
+int main(int argc, char *argv[])
+{
+	unsigned int sample_rate = 22050, per_packet = 256;
+	unsigned int drop = 0, swap = 0, dup = 0;
+	int tcp = 0, realtime = 0;
+	int c, fd, in = 0, i;
+	uint64_t sent = 0;
+	uint32_t seq = 0;
+	struct packet pkt, held;
+	size_t held_len = 0, len;
+	double start;
+
+	while ((c = getopt(argc, argv, "Tr:s:Rd:x:D:h")) != -1) {
+		switch (c) {
+		case 'T':
+			tcp = 1;
+			break;
+		case 'r':
+			sample_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			per_packet = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			realtime = 1;
+			break;
+		case 'd':
+			drop = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			swap = strtoul(optarg, NULL, 0);
+			break;
+		case 'D':
+			dup = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, usage_str, argv[0]);
+			exit(2);
+		}
+	}
+	if (optind >= argc || !sample_rate || !per_packet ||
+	    per_packet > NETPCM_MAXSAMPLES) {
+		fprintf(stderr, usage_str, argv[0]);
+		exit(2);
+	}
+	fd = connect_to(argv[optind++], tcp ? SOCK_STREAM : SOCK_DGRAM);
+	if (optind < argc && strcmp(argv[optind], "-")) {
+		if ((in = open(argv[optind], O_RDONLY)) < 0) {
+			perror("open");
+			exit(10);
+		}
+	}
+
+	start = now();
+	for (;;) {
+		size_t got = 0;
+
+		/* fill whole datagrams, a pipe may deliver less per read() */
+		while (got < per_packet * sizeof(short)) {
+			i = read(in, (char *)pkt.samples + got, per_packet * sizeof(short) - got);
+			if (i < 0 && errno != EAGAIN && errno != EINTR) {
+				perror("read");
+				exit(4);
+			}
+			if (!i)
+				break;
+			if (i > 0)
+				got += i;
+		}
+		got &= ~(size_t)1;
+		if (!got)
+			break;
+
+		if (tcp) {
+			if (write(fd, pkt.samples, got) != (ssize_t)got) {
+				perror("write");
+				exit(4);
+			}
+		} else {
+			seq++;
+			pkt.hdr.magic = htonl(NETPCM_MAGIC);
+			pkt.hdr.seq = htonl(seq);
+			len = sizeof(pkt.hdr) + got;
+			if (drop && !(seq % drop)) {
+				/* lost on the way */
+			} else if (swap && !(seq % swap)) {
+				held = pkt;
+				held_len = len;
+			} else {
+				send_packet(fd, &pkt, len);
+				if (dup && !(seq % dup))
+					send_packet(fd, &pkt, len);
+				if (held_len) {
+					send_packet(fd, &held, held_len);
+					held_len = 0;
+				}
+			}
+		}
+		sent += got / sizeof(short);
+
+		if (realtime) {
+			double ahead = (double)sent / sample_rate - (now() - start);
+			if (ahead > 0) {
+				struct timespec ts = { (time_t)ahead, (long)((ahead - (time_t)ahead) * 1e9) };
+				nanosleep(&ts, NULL);
+			}
+		}
+	}
+
+	if (!tcp) {
+		if (held_len)
+			send_packet(fd, &held, held_len);
+		/* an empty datagram ends the stream */
+		pkt.hdr.magic = htonl(NETPCM_MAGIC);
+		pkt.hdr.seq = htonl(++seq);
+		send_packet(fd, &pkt, sizeof(pkt.hdr));
+	}
+	close(fd);
+	if (in)
+		close(in);
+	exit(0);
+}
@@ -0,0 +1,46 @@
+/*
+ *      netpcm.h -- framing of the UDP sample stream used by the "udp" input
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#ifndef _NETPCM_H
+#define _NETPCM_H
+
+#include <stdint.h>
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Every datagram starts with this header, both fields in network byte
+ * order, followed by up to NETPCM_MAXSAMPLES samples in the raw input
+ * format (signed 16 bit, host byte order of the sender). 'seq' counts
+ * datagrams and wraps at 2^32. A datagram without samples ends the stream.
+ *
+ * TCP carries plain raw samples without any framing.
+ */
+
+#define NETPCM_MAGIC      0x4d4d4e50u  /* "MMNP" */
+#define NETPCM_MAXSAMPLES 2048
+
+struct netpcm_header {
+	uint32_t magic;
+	uint32_t seq;
+};
+
+/* ---------------------------------------------------------------------- */
+#endif /* _NETPCM_H */
@@ -1078,15 +1078,28 @@ static void do_one_bit(struct demod_state *s, uint32_t rx_data)
 
 /* ---------------------------------------------------------------------- */
 
-void pocsag_rxbit(struct demod_state *s, int32_t bit)
+static void pocsag_bit(struct demod_state *s, int32_t bit)
 {
     s->l2.pocsag.rx_data <<= 1;
     s->l2.pocsag.rx_data |= !bit;
-    verbprintf(9, " %c ", '1'-(s->l2.pocsag.rx_data & 1));
     if(pocsag_invert_input)
         do_one_bit(s, ~(s->l2.pocsag.rx_data)); // this tries the inverted signal
     else
         do_one_bit(s, s->l2.pocsag.rx_data);
 }
 
+void pocsag_rxbit(struct demod_state *s, int32_t bit)
+{
+    bitdump_rx(s, BITDUMP_POCSAG, bit);
+    pocsag_bit(s, bit);
+}
+
+void pocsag_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits)
+{
+    unsigned int i;
+
+    for (i = 0; i < nbits; i++)
+        pocsag_bit(s, rxbits_bit(bits, i));
+}
+
 /* ---------------------------------------------------------------------- */
@@ -28,23 +28,248 @@
 #include "filter.h"
 #include <math.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 /* ---------------------------------------------------------------------- */
 
 #define SAMPLE_RATE 22050
-#define BLOCKLEN (SAMPLE_RATE/100)  /* 10ms blocks */
-#define BLOCKNUM 4    /* must match numbers in multimon.h */
+#define DECIM       3                        /* tones are analysed at 7350 Hz */
+#define DECIM_TAPS  SELCALL_OVERLAP
+#define DECIM_CUTOFF 3300
+#define BLOCKLEN    ((SAMPLE_RATE/100+DECIM-1)/DECIM)  /* 10ms blocks, decimated */
+#define BLOCKNUM 4
 #define TIMEOUT_LIMIT 5 //50ms
 
-void selcall_init(struct demod_state *s)
+#define MAX_TONES   64                       /* the eight standards use 48 */
+#define LANES       8
+
+#define PHINC(x) ((x)*0x10000/(SAMPLE_RATE/DECIM))
+
+/*
+ * The selcall standards of one input share a tone analyzer, an engine.
+ * Each distinct tone frequency gets one Goertzel filter, whichever
+ * standards use it, and every enabled standard reads its 16 tones from
+ * the energies of the blocks the engine completed in the current buffer.
+ * The first standard called with a new buffer runs the engine, the others
+ * only look at the results. The Goertzel filters run LANES at a time, in
+ * v8sf vectors.
+ *
+ * With --channels every channel has an engine of its own, see the lanes
+ * at the end.
+ */
+
+typedef union {
+    v8sf v[MAX_TONES / LANES];
+    float f[MAX_TONES];
+} lanes_t;
+
+struct selcall_block {
+    float tote;
+    float totte[MAX_TONES];
+};
+
+struct selcall_engine {
+    unsigned int users;
+    unsigned int ntones;
+    unsigned int hz[MAX_TONES];
+    unsigned int phinc[MAX_TONES];
+    unsigned int ph[MAX_TONES];
+    float cos[MAX_TONES], sin[MAX_TONES];
+    float gain[MAX_TONES];                   /* undoes the decimation filter */
+    lanes_t coef, s1, s2;
+    float energy[BLOCKNUM];
+    float tenergy[BLOCKNUM][2*MAX_TONES];
+    int ring;
+    int blkcount;
+    int subsamp;
+    unsigned int run;                        /* buffers analysed so far */
+    unsigned int nblk, maxblk;               /* blocks completed in the last one */
+    struct selcall_block *blk;
+};
+
+static struct selcall_engine shared;
+/* the engine selcall_init() registers the standard with */
+static struct selcall_engine *init_engine = &shared;
+
+static float decim_filt[DECIM_TAPS];
+
+/* ---------------------------------------------------------------------- */
+
+static void engine_start(struct selcall_engine *e)
+{
+    float sum = 0;
+    int i;
+
+    memset(e, 0, sizeof(*e));
+    e->blkcount = BLOCKLEN;
+    /* Hamming windowed sinc, -50 dB where it would alias onto 2800 Hz */
+    for (i = 0; i < DECIM_TAPS; i++) {
+        float m = i - (DECIM_TAPS - 1) * 0.5f;
+        float x = 2.0f * M_PI * DECIM_CUTOFF / SAMPLE_RATE * m;
+        decim_filt[i] = (0.54f - 0.46f * cosf(2.0f * M_PI * i / (DECIM_TAPS - 1))) * sinf(x) / x;
+        sum += decim_filt[i];
+    }
+    for (i = 0; i < DECIM_TAPS; i++)
+        decim_filt[i] /= sum;
+}
+
+static unsigned char engine_add_tone(struct selcall_engine *e, unsigned int hz)
+{
+    unsigned int t;
+    float hr = 0, hi = 0;
+    int i;
+
+    for (t = 0; t < e->ntones; t++)
+        if (e->hz[t] == hz)
+            return t;
+    if (e->ntones >= MAX_TONES) {
+        fprintf(stderr, "selcall: too many distinct tones\n");
+        exit(1);
+    }
+    t = e->ntones++;
+    e->hz[t] = hz;
+    e->phinc[t] = PHINC(hz);
+    e->cos[t] = cosf(2.0f * M_PI * e->phinc[t] / 0x10000);
+    e->sin[t] = sinf(2.0f * M_PI * e->phinc[t] / 0x10000);
+    e->coef.f[t] = 2.0f * e->cos[t];
+    for (i = 0; i < DECIM_TAPS; i++) {
+        hr += decim_filt[i] * cosf(2.0f * M_PI * hz / SAMPLE_RATE * i);
+        hi += decim_filt[i] * sinf(2.0f * M_PI * hz / SAMPLE_RATE * i);
+    }
+    e->gain[t] = 1.0f / sqrtf(hr * hr + hi * hi);
+    return t;
+}
+
+/* room for the blocks of length more samples */
+static void engine_reserve(struct selcall_engine *e, int length)
+{
+    e->nblk = 0;
+    if (e->maxblk < (unsigned int)length / (BLOCKLEN*DECIM) + 2) {
+        e->maxblk = length / (BLOCKLEN*DECIM) + 2;
+        e->blk = realloc(e->blk, e->maxblk * sizeof(*e->blk));
+        if (!e->blk) {
+            perror("realloc");
+            exit(10);
+        }
+    }
+}
+
+/*
+ * Turn the Goertzel states into this block's correlations with the tones.
+ * Rotated by the phase the tone reference has reached, they add up over
+ * the blocks as if a single oscillator had run through all of them. The
+ * history is a ring, the oldest block is overwritten next.
+ */
+static void engine_block(struct selcall_engine *e)
+{
+    struct selcall_block *b = &e->blk[e->nblk++];
+    float *te = e->tenergy[e->ring];
+    unsigned int t;
+    int j;
+
+    for (t = 0; t < e->ntones; t++) {
+        float yr = (e->s1.f[t] - e->s2.f[t] * e->cos[t]) * e->gain[t];
+        float yi = e->s2.f[t] * e->sin[t] * e->gain[t];
+        unsigned int ph = e->ph[t] + e->phinc[t] * (BLOCKLEN - 1);
+        te[t] = yr * COS(ph) + yi * SIN(ph);
+        te[t+MAX_TONES] = yi * COS(ph) - yr * SIN(ph);
+        e->ph[t] += e->phinc[t] * BLOCKLEN;
+        e->s1.f[t] = e->s2.f[t] = 0;
+    }
+
+    b->tote = 0;
+    for (j = 0; j < BLOCKNUM; j++)
+        b->tote += e->energy[j];
+    for (t = 0; t < e->ntones; t++) {
+        float re = 0, im = 0;
+        for (j = 0; j < BLOCKNUM; j++) {
+            re += e->tenergy[j][t];
+            im += e->tenergy[j][t+MAX_TONES];
+        }
+        b->totte[t] = fsqr(re) + fsqr(im);
+    }
+    e->ring = (e->ring + 1) % BLOCKNUM;
+    e->energy[e->ring] = 0;
+    /* the energy is summed at the full rate, the tones at the decimated one */
+    b->tote *= (BLOCKNUM*BLOCKLEN*0.5/DECIM);  /* adjust for block lengths */
+}
+
+/*
+ * buffer[k + DECIM_TAPS - 1] is the newest sample under the decimation
+ * filter at position k; every DECIM-th position is filtered and fed to
+ * the Goertzel filters, the energy is taken from all samples.
+ */
+static void engine_run(struct selcall_engine *e, const float *buffer, int length)
+{
+    unsigned int nvec = (e->ntones + LANES - 1) / LANES, v;
+    float energy = e->energy[e->ring];
+    int k, i;
+
+    engine_reserve(e, length);
+    for (k = e->subsamp; k < length; k += DECIM) {
+        const float *w = buffer + k;
+        float x = mac(w, decim_filt, DECIM_TAPS);
+
+        for (i = DECIM_TAPS - DECIM; i < DECIM_TAPS; i++)
+            energy += fsqr(w[i]);
+        for (v = 0; v < nvec; v++) {
+#ifdef HAVE_VECTORS
+            v8sf s0 = SPLAT8(x) + e->coef.v[v] * e->s1.v[v] - e->s2.v[v];
+            e->s2.v[v] = e->s1.v[v];
+            e->s1.v[v] = s0;
+#else
+            for (i = v * LANES; i < (int)(v + 1) * LANES; i++) {
+                float s0 = x + e->coef.f[i] * e->s1.f[i] - e->s2.f[i];
+                e->s2.f[i] = e->s1.f[i];
+                e->s1.f[i] = s0;
+            }
+#endif
+        }
+        if (--e->blkcount <= 0) {
+            e->blkcount = BLOCKLEN;
+            e->energy[e->ring] = energy;
+            engine_block(e);
+            energy = 0;
+        }
+    }
+    e->subsamp = k - length;
+    e->energy[e->ring] = energy;
+    e->run++;
+}
+
+/* ---------------------------------------------------------------------- */
+
+void selcall_init(struct demod_state *s, const unsigned int *selcall_freq)
 {
+    struct selcall_engine *e = init_engine;
+    int i;
+
     memset(&s->l1.selcall, 0, sizeof(s->l1.selcall));
+    if (!e->users)
+        engine_start(e);
+    e->users++;
+    for (i = 0; i < 16; i++)
+        s->l1.selcall.tone[i] = engine_add_tone(e, selcall_freq[i]);
+    s->l1.selcall.eng = e;
+    s->l1.selcall.run = e->run;
+    s->l1.selcall.chan = -1;
 }
 
 void selcall_deinit(struct demod_state *s)
 {
-    if(s->l1.selcall.timeout != 0)
-        verbprintf(0, "\n");
+    struct selcall_engine *e = s->l1.selcall.eng;
+
+    if(s->l1.selcall.timeout != 0) {
+        if (s->l1.selcall.chan >= 0)
+            verbprintf(0, "%s\n", s->l1.selcall.line);
+        else
+            verbprintf(0, "\n");
+    }
+    if (!--e->users) {
+        free(e->blk);
+        e->blk = NULL;
+    }
 }
 
 int find_max_idx(const float *f)
@@ -66,29 +291,14 @@ int find_max_idx(const float *f)
     return idx;
 }
 
-static inline int process_block(struct demod_state *s)
+static inline int process_block(struct demod_state *s, const struct selcall_block *b)
 {
-    float tote;
-    float totte[32];
-    int i, j;
+    float tote = b->tote;
+    float totte[16];
+    int i;
 
-    tote = 0;
-    for (i = 0; i < BLOCKNUM; i++)
-        tote += s->l1.selcall.energy[i];
-    for (i = 0; i < 32; i++) {
-        totte[i] = 0;
-        for (j = 0; j < BLOCKNUM; j++)
-            totte[i] += s->l1.selcall.tenergy[j][i];
-    }
     for (i = 0; i < 16; i++)
-        totte[i] = fsqr(totte[i]) + fsqr(totte[i+16]);
-    memmove(s->l1.selcall.energy+1, s->l1.selcall.energy,
-            sizeof(s->l1.selcall.energy) - sizeof(s->l1.selcall.energy[0]));
-    s->l1.selcall.energy[0] = 0;
-    memmove(s->l1.selcall.tenergy+1, s->l1.selcall.tenergy,
-            sizeof(s->l1.selcall.tenergy) - sizeof(s->l1.selcall.tenergy[0]));
-    memset(s->l1.selcall.tenergy, 0, sizeof(s->l1.selcall.tenergy[0]));
-    tote *= (BLOCKNUM*BLOCKLEN*0.5);  /* adjust for block lengths */
+        totte[i] = b->totte[s->l1.selcall.tone[i]];
     verbprintf(10, "selcall: Energies: %8.5f  %8.5f %8.5f %8.5f %8.5f %8.5f %8.5f %8.5f %8.5f"
                " %8.5f %8.5f %8.5f %8.5f %8.5f %8.5f %8.5f %8.5f\n",
                tote, totte[0], totte[1], totte[2], totte[3], totte[4], totte[5], totte[6], totte[7],
@@ -100,40 +310,252 @@ static inline int process_block(struct demod_state *s)
     return i;
 }
 
-void selcall_demod(struct demod_state *s, const float *buffer, int length,
-                   const unsigned int *selcall_freq, const char * const name)
+/*
+ * Digits are printed as they come in. On a channel of --channels the
+ * line is collected instead and printed whole, with the channel in front,
+ * so that the lines of the channels do not run into each other.
+ */
+static void line_start(struct demod_state *s, const char *name)
+{
+    struct l1_state_selcall *sc = &s->l1.selcall;
+
+    if (sc->chan < 0) {
+        verbprintf(0, "%s: ", name);
+        return;
+    }
+    sc->len = snprintf(sc->line, sizeof(sc->line), "CH%d: %s: ", sc->chan, name);
+    sc->start = sc->len;
+}
+
+static void line_digit(struct demod_state *s, int i)
+{
+    struct l1_state_selcall *sc = &s->l1.selcall;
+
+    if (sc->chan < 0) {
+        verbprintf(0, "%1X", i);
+        return;
+    }
+    if (sc->len + 1 >= sizeof(sc->line)) {
+        /* a very long sequence goes on on the next line */
+        verbprintf(0, "%s\n", sc->line);
+        sc->len = sc->start;
+    }
+    sc->line[sc->len++] = "0123456789ABCDEF"[i];
+    sc->line[sc->len] = 0;
+}
+
+static void line_end(struct demod_state *s)
+{
+    if (s->l1.selcall.chan < 0)
+        verbprintf(0, "\n");
+    else
+        verbprintf(0, "%s\n", s->l1.selcall.line);
+}
+
+static void selcall_decide(struct demod_state *s, const char *name)
 {
-    float s_in;
+    struct selcall_engine *e = s->l1.selcall.eng;
+    unsigned int b;
     int i;
 
-    for (; length > 0; length--, buffer++) {
-        s_in = *buffer;
-        s->l1.selcall.energy[0] += fsqr(s_in);
-        for (i = 0; i < 16; i++) {
-            s->l1.selcall.tenergy[0][i] += COS(s->l1.selcall.ph[i]) * s_in;
-            s->l1.selcall.tenergy[0][i+16] += SIN(s->l1.selcall.ph[i]) * s_in;
-            s->l1.selcall.ph[i] += selcall_freq[i];
+    for (b = 0; b < e->nblk; b++) {
+        i = process_block(s, &e->blk[b]);
+        if (i != s->l1.selcall.lastch && i >= 0)
+        {
+            if(s->l1.selcall.timeout == 0)
+                line_start(s, name);
+            line_digit(s, i);
+            s->l1.selcall.timeout = 1;
         }
-        if ((s->l1.selcall.blkcount--) <= 0) {
-            s->l1.selcall.blkcount = BLOCKLEN;
-            i = process_block(s);
-            if (i != s->l1.selcall.lastch && i >= 0)
-            {
-                if(s->l1.selcall.timeout == 0)
-                    verbprintf(0, "%s: ", name);
-                verbprintf(0, "%1X", i);
-                s->l1.selcall.timeout = 1;
-            }
 
-            if(i == -1 && s->l1.selcall.timeout != 0)
-                s->l1.selcall.timeout++;
-            if(s->l1.selcall.timeout > TIMEOUT_LIMIT+1)
-            {
-                verbprintf(0, "\n");
-                s->l1.selcall.timeout = 0;
+        if(i == -1 && s->l1.selcall.timeout != 0)
+            s->l1.selcall.timeout++;
+        if(s->l1.selcall.timeout > TIMEOUT_LIMIT+1)
+        {
+            line_end(s);
+            s->l1.selcall.timeout = 0;
+        }
+
+        s->l1.selcall.lastch = i;
+    }
+}
+
+void selcall_demod(struct demod_state *s, const float *buffer, int length,
+                   const char * const name)
+{
+    struct selcall_engine *e = s->l1.selcall.eng;
+
+    if (s->l1.selcall.run == e->run)
+        engine_run(e, buffer, length);
+    s->l1.selcall.run = e->run;
+    selcall_decide(s, name);
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Several channels at once (--channels): each channel has an engine of
+ * its own and every enabled standard a state per channel, but the
+ * Goertzel filters run with one channel per lane, so that a vector holds
+ * one tone of eight channels. The interleaved input is transposed into
+ * that layout and decimated lane by lane. At the end of every block, each
+ * lane is copied into the engine of its channel, which turns it into a
+ * block of energies as usual, and after every chunk the standards of each
+ * channel decide on the blocks of their engine.
+ */
+
+#define LANES_CHUNK  1024   /* frames transposed at a time */
+#define MAX_STANDARDS 8
+
+static struct {
+    unsigned int nchan, nstd;
+    float scale;
+    int blkcount;
+    int subsamp;
+    const struct demod_param *std[MAX_STANDARDS];
+    struct demod_state *st;                  /* [channel][standard] */
+    struct selcall_engine eng[CHANNELS_MAX];
+    struct lane_group {
+        v8sf s1[MAX_TONES], s2[MAX_TONES];
+        v8sf energy;
+        v8sf x[DECIM_TAPS - 1 + LANES_CHUNK];   /* with the filter history */
+    } grp[CHANNELS_MAX / LANES];
+} lanes;
+
+void selcall_lanes_init(unsigned int nchan, const struct demod_param *const *std, unsigned int nstd)
+{
+    struct demod_state *s;
+    unsigned int c, k;
+
+    if (nstd > MAX_STANDARDS) {
+        fprintf(stderr, "selcall: more than %d standards\n", MAX_STANDARDS);
+        exit(2);
+    }
+    memset(&lanes, 0, sizeof(lanes));
+    lanes.nchan = nchan;
+    lanes.nstd = nstd;
+    lanes.scale = ingest_gain * (1.0f/32768.0f);
+    lanes.blkcount = BLOCKLEN;
+    memcpy(lanes.std, std, nstd * sizeof(std[0]));
+    if (!(lanes.st = calloc(nchan * nstd, sizeof(*lanes.st)))) {
+        perror("calloc");
+        exit(10);
+    }
+    for (c = 0; c < nchan; c++) {
+        init_engine = &lanes.eng[c];
+        for (k = 0; k < nstd; k++) {
+            s = &lanes.st[c * nstd + k];
+            s->dem_par = std[k];
+            std[k]->init(s);
+            s->l1.selcall.chan = c;
+        }
+    }
+    init_engine = &shared;
+}
+
+void selcall_lanes_deinit(void)
+{
+    unsigned int c, k;
+
+    if (!lanes.st)
+        return;
+    for (c = 0; c < lanes.nchan; c++)
+        for (k = 0; k < lanes.nstd; k++)
+            if (lanes.std[k]->deinit)
+                lanes.std[k]->deinit(&lanes.st[c * lanes.nstd + k]);
+    free(lanes.st);
+    lanes.st = NULL;
+}
+
+static void lanes_block(unsigned int ngrp)
+{
+    struct selcall_engine *e;
+    unsigned int g, l, c, t;
+
+    for (g = 0; g < ngrp; g++) {
+        struct lane_group *gr = &lanes.grp[g];
+        for (l = 0; l < LANES && (c = g * LANES + l) < lanes.nchan; l++) {
+            e = &lanes.eng[c];
+            for (t = 0; t < e->ntones; t++) {
+                e->s1.f[t] = LANE(gr->s1[t], l);
+                e->s2.f[t] = LANE(gr->s2[t], l);
             }
+            e->energy[e->ring] = LANE(gr->energy, l);
+            engine_block(e);
+        }
+        memset(gr->s1, 0, sizeof(gr->s1));
+        memset(gr->s2, 0, sizeof(gr->s2));
+        memset(&gr->energy, 0, sizeof(gr->energy));
+    }
+}
 
-            s->l1.selcall.lastch = i;
+/*
+ * frames[] holds nframes frames of nchan interleaved samples.
+ */
+void selcall_lanes_demod(const short *frames, unsigned int nframes)
+{
+    unsigned int ngrp = (lanes.nchan + LANES - 1) / LANES;
+    unsigned int ntones = lanes.eng[0].ntones;
+    const float *coef = lanes.eng[0].coef.f;
+    unsigned int n, f, g, l, c, t, k;
+    int j, i;
+
+    for (; nframes > 0; nframes -= n, frames += n * lanes.nchan) {
+        n = nframes > LANES_CHUNK ? LANES_CHUNK : nframes;
+        for (g = 0; g < ngrp; g++) {
+            v8sf *x = lanes.grp[g].x + DECIM_TAPS - 1;
+            for (f = 0; f < n; f++)
+                for (l = 0; l < LANES; l++) {
+                    c = g * LANES + l;
+                    LANE(x[f], l) = c < lanes.nchan ?
+                        frames[f * lanes.nchan + c] * lanes.scale : 0;
+                }
         }
+        for (c = 0; c < lanes.nchan; c++)
+            engine_reserve(&lanes.eng[c], n);
+
+        for (j = lanes.subsamp; j < (int)n; j += DECIM) {
+            for (g = 0; g < ngrp; g++) {
+                struct lane_group *gr = &lanes.grp[g];
+                const v8sf *w = gr->x + j;
+#ifdef HAVE_VECTORS
+                v8sf y = SPLAT8(0);
+                for (i = 0; i < DECIM_TAPS; i++)
+                    y += SPLAT8(decim_filt[i]) * w[i];
+                for (i = DECIM_TAPS - DECIM; i < DECIM_TAPS; i++)
+                    gr->energy += w[i] * w[i];
+                for (t = 0; t < ntones; t++) {
+                    v8sf s0 = y + SPLAT8(coef[t]) * gr->s1[t] - gr->s2[t];
+                    gr->s2[t] = gr->s1[t];
+                    gr->s1[t] = s0;
+                }
+#else
+                for (l = 0; l < LANES; l++) {
+                    float y = 0;
+                    for (i = 0; i < DECIM_TAPS; i++)
+                        y += decim_filt[i] * LANE(w[i], l);
+                    for (i = DECIM_TAPS - DECIM; i < DECIM_TAPS; i++)
+                        LANE(gr->energy, l) += fsqr(LANE(w[i], l));
+                    for (t = 0; t < ntones; t++) {
+                        float s0 = y + coef[t] * LANE(gr->s1[t], l) - LANE(gr->s2[t], l);
+                        LANE(gr->s2[t], l) = LANE(gr->s1[t], l);
+                        LANE(gr->s1[t], l) = s0;
+                    }
+                }
+#endif
+            }
+            if (--lanes.blkcount <= 0) {
+                lanes.blkcount = BLOCKLEN;
+                lanes_block(ngrp);
+            }
+        }
+        lanes.subsamp = j - (int)n;
+
+        for (g = 0; g < ngrp; g++)
+            memmove(lanes.grp[g].x, lanes.grp[g].x + n,
+                    (DECIM_TAPS - 1) * sizeof(lanes.grp[g].x[0]));
+        for (c = 0; c < lanes.nchan; c++)
+            for (k = 0; k < lanes.nstd; k++)
+                selcall_decide(&lanes.st[c * lanes.nstd + k], lanes.std[k]->name);
     }
 }
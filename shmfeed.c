@@ -0,0 +1,238 @@
+/*
+ *      shmfeed.c -- reference producer for multimon-ng's "shm" input
+ *
+ *      Copies raw 16 bit samples from a file or standard input into a
+ *      shared memory sample ring (see shmring.h), so the shm input can be
+ *      exercised without an SDR frontend.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#include "shmring.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* ---------------------------------------------------------------------- */
+
+#define BLOCKLEN 1024
+#define POLL_NS  1000000
+
+static void sleep_ns(long ns)
+{
+	struct timespec ts = { ns / 1000000000L, ns % 1000000000L };
+
+	nanosleep(&ts, NULL);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static const char usage_str[] = "shmfeed-ng\n"
+"Feeds raw signed 16 bit samples into a shared memory ring for multimon-ng\n"
+"usage: %s [options] [file]\n"
+"  -n <name>  : shared memory object name (default: /multimon-ng)\n"
+"  -r <rate>  : sample rate (default: 22050)\n"
+"  -c <n>     : ring capacity in samples, rounded up to a power of two\n"
+"               (default: 65536)\n"
+"  -f <fmt>   : ring format, s16 or f32 (default: s16)\n"
+"  -R         : pace the output in real time\n"
+"  -w         : wait for a reader and never overwrite unread samples\n"
+"  -h         : this help\n"
+"  Reads standard input if no file is given.\n";
+
+int main(int argc, char *argv[])
+{
+	const char *name = "/multimon-ng";
+	unsigned int sample_rate = 22050;
+	unsigned int capacity = 65536;
+	unsigned int format = SHMRING_FMT_S16;
+	int realtime = 0, lossless = 0;
+	int c, fd, in = 0, i;
+	size_t size;
+	struct shmring_header *hdr;
+	unsigned char *data;
+	short buf[BLOCKLEN];
+	uint64_t wr = 0, rd, lost = 0;
+	double start;
+
+	while ((c = getopt(argc, argv, "n:r:c:f:Rwh")) != -1) {
+		switch (c) {
+		case 'n':
+			name = optarg;
+			break;
+		case 'r':
+			sample_rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			capacity = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			if (!strcmp(optarg, "s16"))
+				format = SHMRING_FMT_S16;
+			else if (!strcmp(optarg, "f32"))
+				format = SHMRING_FMT_F32;
+			else {
+				fprintf(stderr, "invalid format \"%s\"\n", optarg);
+				exit(2);
+			}
+			break;
+		case 'R':
+			realtime = 1;
+			break;
+		case 'w':
+			lossless = 1;
+			break;
+		default:
+			fprintf(stderr, usage_str, argv[0]);
+			exit(2);
+		}
+	}
+	if (!sample_rate || capacity < BLOCKLEN) {
+		fprintf(stderr, usage_str, argv[0]);
+		exit(2);
+	}
+	for (i = BLOCKLEN; (unsigned int)i < capacity; i <<= 1);
+	capacity = i;
+
+	if (optind < argc && strcmp(argv[optind], "-")) {
+		if ((in = open(argv[optind], O_RDONLY)) < 0) {
+			perror("open");
+			exit(10);
+		}
+	}
+
+	/*
+	 * always start from a fresh object, so that a reader can never see
+	 * a stale header of a previous run
+	 */
+	shm_unlink(name);
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) {
+		perror("shm_open");
+		exit(10);
+	}
+	size = SHMRING_HEADER_SIZE + (size_t)capacity * shmring_sample_size(format);
+	if (ftruncate(fd, size)) {
+		perror("ftruncate");
+		exit(10);
+	}
+	hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		perror("mmap");
+		exit(10);
+	}
+	close(fd);
+	data = (unsigned char *)hdr + SHMRING_HEADER_SIZE;
+
+	hdr->version = SHMRING_VERSION;
+	hdr->header_size = SHMRING_HEADER_SIZE;
+	hdr->format = format;
+	hdr->sample_rate = sample_rate;
+	hdr->capacity = capacity;
+	shmring_store(&hdr->magic, SHMRING_MAGIC);
+
+	if (lossless)
+		while (!shmring_load(&hdr->consumers))
+			sleep_ns(POLL_NS);
+
+	start = now();
+	for (;;) {
+		unsigned int n, done, off, cnt;
+
+		i = read(in, buf, sizeof(buf));
+		if (i < 0 && errno != EAGAIN) {
+			perror("read");
+			exit(4);
+		}
+		if (!i)
+			break;
+		if (i < 0)
+			continue;
+		n = i / sizeof(buf[0]);
+
+		rd = shmring_load(&hdr->read_index);
+		if (lossless) {
+			while (wr + n - rd > capacity) {
+				sleep_ns(POLL_NS);
+				rd = shmring_load(&hdr->read_index);
+			}
+		} else if (shmring_load(&hdr->consumers) && wr + n - rd > capacity) {
+			/* samples below wr+n-capacity that the reader did not get */
+			uint64_t from = wr > capacity ? wr - capacity : 0;
+			uint64_t to = wr + n - capacity;
+			if (rd > from)
+				from = rd;
+			if (to > from) {
+				lost += to - from;
+				shmring_store(&hdr->overruns, lost);
+			}
+		}
+
+		shmring_store(&hdr->write_reserve, wr + n);
+		shmring_fence(__ATOMIC_RELEASE);
+		for (done = 0; done < n; done += cnt) {
+			off = (wr + done) & (capacity - 1);
+			cnt = n - done;
+			if (cnt > capacity - off)
+				cnt = capacity - off;
+			if (format == SHMRING_FMT_S16) {
+				memcpy(data + off * sizeof(short), buf + done, cnt * sizeof(short));
+			} else {
+				float *fp = (float *)data + off;
+				unsigned int k;
+				for (k = 0; k < cnt; k++)
+					fp[k] = buf[done + k] * (1.0f/32768.0f);
+			}
+		}
+		wr += n;
+		shmring_store(&hdr->write_index, wr);
+
+		if (realtime) {
+			double ahead = (double)wr / sample_rate - (now() - start);
+			if (ahead > 0)
+				sleep_ns(ahead * 1e9);
+		}
+	}
+
+	__atomic_or_fetch(&hdr->flags, SHMRING_FLAG_EOF, __ATOMIC_RELEASE);
+	if (lossless)
+		while (shmring_load(&hdr->consumers) &&
+		       shmring_load(&hdr->read_index) != wr)
+			sleep_ns(POLL_NS);
+	if (lost)
+		fprintf(stderr, "shmfeed: %llu samples overwritten before they were read\n",
+			(unsigned long long)lost);
+	shm_unlink(name);
+	munmap(hdr, size);
+	if (in)
+		close(in);
+	exit(0);
+}
@@ -0,0 +1,83 @@
+/*
+ *      shmring.h -- shared memory sample ring used by the "shm" input
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+#ifndef _SHMRING_H
+#define _SHMRING_H
+
+#include <stdint.h>
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * A POSIX shared memory object (shm_open()) holding one header followed
+ * by a ring of 'capacity' samples. There is exactly one producer, which
+ * creates the object, fills in the header and stores 'magic' last.
+ *
+ * write_index, write_reserve and read_index count samples since the ring
+ * was created and never wrap; the slot of sample n is n & (capacity-1).
+ * The producer only ever writes write_index, write_reserve, overruns and
+ * flags; the consumer only ever writes read_index and consumers. A
+ * producer that does not wait for the reader adds every sample it
+ * overwrites unread to 'overruns'.
+ *
+ * To write samples [w, e) the producer first stores e to write_reserve
+ * (followed by a release fence), then fills the slots, then stores e to
+ * write_index; e - w never exceeds capacity. Samples below write_index are
+ * complete. A consumer copies from the ring, issues an acquire fence and
+ * then reloads write_reserve: if write_reserve - n > capacity, sample n
+ * may have been overwritten during the copy and must not be used.
+ */
+
+#define SHMRING_MAGIC    0x47524d4du  /* "MMRG" */
+#define SHMRING_VERSION  2
+
+#define SHMRING_FMT_S16  1            /* signed 16 bit, host byte order */
+#define SHMRING_FMT_F32  2            /* float, full scale is +-1.0 */
+
+#define SHMRING_FLAG_EOF 0x1          /* producer is done, drain and stop */
+
+struct shmring_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;         /* offset of the sample data */
+	uint32_t format;
+	uint32_t sample_rate;
+	uint32_t capacity;            /* in samples, a power of two */
+	uint32_t flags;
+	uint32_t consumers;           /* number of attached readers */
+	uint64_t write_index;         /* end of the complete samples */
+	uint64_t write_reserve;       /* end of the write in progress */
+	uint64_t read_index;
+	uint64_t overruns;            /* samples overwritten before being read */
+};
+
+#define SHMRING_HEADER_SIZE 64
+
+static inline uint32_t shmring_sample_size(uint32_t format)
+{
+	return format == SHMRING_FMT_F32 ? sizeof(float) : sizeof(int16_t);
+}
+
+#define shmring_load(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define shmring_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define shmring_fence(m)    __atomic_thread_fence(m)
+
+/* ---------------------------------------------------------------------- */
+#endif /* _SHMRING_H */
@@ -67,7 +67,7 @@ void uart_init(struct demod_state *s)
 
 /* ---------------------------------------------------------------------- */
 
-void uart_rxbit(struct demod_state *s, int bit)
+static void uart_bit(struct demod_state *s, int bit)
 {
 	s->l2.uart.rxbitstream <<= 1;
 	s->l2.uart.rxbitstream |= !!bit;
@@ -111,4 +111,18 @@ void uart_rxbit(struct demod_state *s, int bit)
       	s->l2.uart.rxbitbuf >>= 1;
 }
 
+void uart_rxbit(struct demod_state *s, int bit)
+{
+	bitdump_rx(s, BITDUMP_UART, bit);
+	uart_bit(s, bit);
+}
+
+void uart_rxbits(struct demod_state *s, const unsigned char *bits, unsigned int nbits)
+{
+	unsigned int i;
+
+	for (i = 0; i < nbits; i++)
+		uart_bit(s, rxbits_bit(bits, i));
+}
+
 /* ---------------------------------------------------------------------- */
@@ -24,6 +24,10 @@
 
 /* ---------------------------------------------------------------------- */
 
+#if defined(NET_INPUT) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* recvmmsg() */
+#endif
+
 #include "multimon.h"
 #include <stdio.h>
 #include <stdarg.h>
@@ -62,11 +66,32 @@
 #include <sys/wait.h>
 #endif
 
+#include "actindex.h"
+
+#ifdef SHM_INPUT
+#include <sys/mman.h>
+#include "shmring.h"
+#endif
+
+#ifdef NET_INPUT
+#include <sys/socket.h>
+#include <netdb.h>
+#include "netpcm.h"
+#endif
+
 /* ---------------------------------------------------------------------- */
 
 static const char *allowed_types[] = {
     "raw", "aiff", "au", "hcom", "sf", "voc", "cdr", "dat",
-    "smp", "wav", "maud", "vwe", "mp3", "mp4", "ogg", "flac", NULL
+    "smp", "wav", "maud", "vwe", "mp3", "mp4", "ogg", "flac",
+#ifdef SHM_INPUT
+    "shm",
+#endif
+#ifdef NET_INPUT
+    "udp", "tcp",
+#endif
+    "bits",
+    NULL
 };
 
 /* ---------------------------------------------------------------------- */
@@ -77,11 +102,26 @@ static const struct demod_param *dem[] = { ALL_DEMOD };
 
 static struct demod_state dem_st[NUMDEMOD];
 static unsigned int dem_mask[(NUMDEMOD+31)/32];
+static struct sample_ingest ingest;
 
 #define MASK_SET(n) dem_mask[(n)>>5] |= 1<<((n)&0x1f)
 #define MASK_RESET(n) dem_mask[(n)>>5] &= ~(1<<((n)&0x1f))
 #define MASK_ISSET(n) (dem_mask[(n)>>5] & 1<<((n)&0x1f))
 
+/*
+ * All demodulators at the usual sample rate; those that need another one
+ * have to be asked for with -a
+ */
+static void mask_all(void)
+{
+    unsigned int i;
+
+    memset(dem_mask, 0, sizeof(dem_mask));
+    for (i = 0; i < NUMDEMOD; i++)
+        if (dem[i]->samplerate == dem[0]->samplerate)
+            MASK_SET(i);
+}
+
 /* ---------------------------------------------------------------------- */
 
 static int verbose_level = 0;
@@ -92,6 +132,17 @@ static bool dont_flush = false;
 static bool is_startline = true;
 static int timestamp = 0;
 static char *label = NULL;
+static char *index_file = NULL;
+static char *bitdump_file = NULL;
+static char *kiss_spec = NULL;
+static unsigned int channels = 1;
+static bool channels_dtmf, channels_selcall;
+
+/* the demodulators that run on the selcall engine, with --channels too */
+static const struct demod_param *const selcall_demods[] = {
+    &demod_zvei1, &demod_zvei2, &demod_zvei3, &demod_dzvei,
+    &demod_pzvei, &demod_eea, &demod_eia, &demod_ccir
+};
 
 extern bool fms_justhex;
 
@@ -103,7 +154,11 @@ extern int pocsag_heuristic_pruning;
 extern int pocsag_prune_empty;
 extern bool pocsag_init_charset(char *charset);
 
+extern unsigned int flex_threads;
+
 extern int aprs_mode;
+extern unsigned int hdlc_fix_max;
+extern unsigned int afsk12_slicers;
 extern int cw_dit_length;
 extern int cw_gap_length;
 extern int cw_threshold;
@@ -114,29 +169,66 @@ void quit(void);
 
 /* ---------------------------------------------------------------------- */
 
-void _verbprintf(int verb_level, const char *fmt, ...)
+#if defined(_MSC_VER)
+static __declspec(thread) struct verb_buffer *verb_capture_buf;
+#else
+static __thread struct verb_buffer *verb_capture_buf;
+#endif
+
+static void line_prefix(void)
 {
 	char time_buf[20];
 	time_t t;
-	struct tm* tm_info;
+	struct tm tm_buf, *tm_info;
+
+    if (label != NULL)
+        fprintf(stdout, "%s: ", label);
+
+    if (timestamp) {
+        t = time(NULL);
+        tm_info = localtime_r(&t, &tm_buf);
+        strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", tm_info);
+        fprintf(stdout, "%s: ", time_buf);
+    }
+}
+
+static void verb_append(struct verb_buffer *vb, const char *fmt, va_list args)
+{
+    va_list again;
+    int n;
+
+    va_copy(again, args);
+    n = vsnprintf(vb->buf + vb->len, vb->size - vb->len, fmt, args);
+    if (n >= 0 && vb->len + n >= vb->size) {
+        size_t size = 2 * (vb->len + n + 1);
+        char *buf = realloc(vb->buf, size);
+        if (buf) {
+            vb->buf = buf;
+            vb->size = size;
+            vsnprintf(vb->buf + vb->len, vb->size - vb->len, fmt, again);
+        }
+    }
+    if (n >= 0 && vb->len + n < vb->size)
+        vb->len += n;
+    va_end(again);
+}
 
+void _verbprintf(int verb_level, const char *fmt, ...)
+{
     if (verb_level > verbose_level)
         return;
     va_list args;
     va_start(args, fmt);
 
+    if (verb_capture_buf) {
+        verb_append(verb_capture_buf, fmt, args);
+        va_end(args);
+        return;
+    }
+
     if (is_startline)
     {
-        if (label != NULL)
-            fprintf(stdout, "%s: ", label);
-
-        if (timestamp) {
-            t = time(NULL);
-            tm_info = localtime(&t);
-            strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", tm_info);
-            fprintf(stdout, "%s: ", time_buf);
-        }
-
+        line_prefix();
         is_startline = false;
     }
     if (NULL != strchr(fmt,'\n')) /* detect end of line in stream */
@@ -148,6 +240,34 @@ void _verbprintf(int verb_level, const char *fmt, ...)
     va_end(args);
 }
 
+/*
+ * Collect the calling thread's output in vb instead of printing it, until
+ * called with NULL.
+ */
+void verb_capture(struct verb_buffer *vb)
+{
+    verb_capture_buf = vb;
+}
+
+void verb_release(struct verb_buffer *vb)
+{
+    size_t pos = 0, n;
+    char *nl;
+
+    while (pos < vb->len) {
+        nl = memchr(vb->buf + pos, '\n', vb->len - pos);
+        n = nl ? (size_t)(nl - (vb->buf + pos)) + 1 : vb->len - pos;
+        if (is_startline)
+            line_prefix();
+        fwrite(vb->buf + pos, 1, n, stdout);
+        is_startline = nl != NULL;
+        pos += n;
+    }
+    if (vb->len && !dont_flush)
+        fflush(stdout);
+    vb->len = 0;
+}
+
 /* ---------------------------------------------------------------------- */
 
 void process_buffer(float *float_buf, short *short_buf, unsigned int len)
@@ -158,6 +278,21 @@ void process_buffer(float *float_buf, short *short_buf, unsigned int len)
             buffer_t buffer = {short_buf, float_buf};
             dem[i]->demod(dem_st+i, buffer, len);
         }
+    if (bitdump_enabled)
+        bitdump_block(len);
+#ifdef KISS_OUTPUT
+    if (kiss_enabled)
+        kiss_poll();
+#endif
+}
+
+/* bit stream replay looks up the enabled demodulator that recorded a stream */
+static struct demod_state *find_demod(const char *name)
+{
+    for (unsigned int i = 0; i < NUMDEMOD; i++)
+        if (MASK_ISSET(i) && !strcmp(dem[i]->name, name))
+            return dem_st+i;
+    return NULL;
 }
 
 /* ---------------------------------------------------------------------- */
@@ -170,11 +305,9 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
     audio_info_t audioinfo2;
     audio_device_t audiodev;
     int fd;
-    short buffer[8192];
-    float fbuf[16384];
-    unsigned int fbuf_cnt = 0;
     int i;
     short *sp;
+    unsigned int space;
 
     if ((fd = open(ifname ? ifname : "/dev/audio", O_RDONLY)) < 0) {
         perror("open");
@@ -207,8 +340,10 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
     fprintf(stdout, "Audio device: name %s, ver %s, config %s, "
             "sampling rate %d\n", audiodev.name, audiodev.version,
             audiodev.config, audioinfo.record.sample_rate);
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
     for (;;) {
-        i = read(fd, sp = buffer, sizeof(buffer));
+        sp = ingest_buffer(&ingest, &space);
+        i = read(fd, sp, space*sizeof(sp[0]));
         if (i < 0 && errno != EAGAIN) {
             perror("read");
             exit(4);
@@ -216,22 +351,9 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
         if (!i)
             break;
         if (i > 0) {
-            if(integer_only)
-        {
-                fbuf_cnt = i/sizeof(buffer[0]);
-        }
-            else
-            {
-                for (; i >= sizeof(buffer[0]); i -= sizeof(buffer[0]), sp++)
-                    fbuf[fbuf_cnt++] = (*sp) * (1.0/32768.0);
-                if (i)
-                    fprintf(stderr, "warning: noninteger number of samples read\n");
-            }
-            if (fbuf_cnt > overlap) {
-                process_buffer(fbuf, buffer, fbuf_cnt-overlap);
-                memmove(fbuf, fbuf+fbuf_cnt-overlap, overlap*sizeof(fbuf[0]));
-                fbuf_cnt = overlap;
-            }
+            if (i % sizeof(sp[0]))
+                fprintf(stderr, "warning: noninteger number of samples read\n");
+            ingest_commit(&ingest, i/sizeof(sp[0]));
         }
     }
     close(fd);
@@ -253,12 +375,10 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
                         const char *ifname)
 {
 
-    short buffer[8192];
-    float fbuf[16384];
-    unsigned int fbuf_cnt = 0;
     int i;
     int error;
     short *sp;
+    unsigned int space;
 
     (void) ifname;  // Suppress the warning.
 
@@ -278,35 +398,17 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
         exit(4);
     }
 
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
     for (;;) {
-        i = pa_simple_read(s, sp = buffer, sizeof(buffer), &error);
+        sp = ingest_buffer(&ingest, &space);
+        i = pa_simple_read(s, sp, space*sizeof(sp[0]), &error);
         if (i < 0 && errno != EAGAIN) {
             perror("read");
             fprintf(stderr, "error 1\n");
             exit(4);
         }
-        i=sizeof(buffer);
-        if (!i)
-            break;
-
-        if (i > 0) {
-            if(integer_only)
-        {
-                fbuf_cnt = i/sizeof(buffer[0]);
-        }
-            else
-            {
-                for (; (unsigned int) i >= sizeof(buffer[0]); i -= sizeof(buffer[0]), sp++)
-                    fbuf[fbuf_cnt++] = (*sp) * (1.0/32768.0);
-                if (i)
-                    fprintf(stderr, "warning: noninteger number of samples read\n");
-            }
-            if (fbuf_cnt > overlap) {
-                process_buffer(fbuf, buffer, fbuf_cnt-overlap);
-                memmove(fbuf, fbuf+fbuf_cnt-overlap, overlap*sizeof(fbuf[0]));
-                fbuf_cnt = overlap;
-            }
-        }
+        /* pa_simple_read() always fills the whole buffer */
+        ingest_commit(&ingest, space);
     }
     pa_simple_free(s);
 }
@@ -319,15 +421,9 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
 {
     int sndparam;
     int fd;
-    union {
-        short s[8192];
-        unsigned char b[8192];
-    } b;
-    float fbuf[16384];
-    unsigned int fbuf_cnt = 0;
     int i;
     short *sp;
-    unsigned char *bp;
+    unsigned int space;
     int fmt = 0;
 
     if ((fd = open(ifname ? ifname : "/dev/dsp", O_RDONLY)) < 0) {
@@ -383,6 +479,7 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
         perror("ioctl: SOUND_PCM_SUBDIVIDE");
     }
 #endif
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
     for (;;) {
         if (fmt) {
             perror("ioctl: 8BIT SAMPLES NOT SUPPORTED!");
@@ -406,7 +503,8 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
             //                }
             //            }
         } else {
-            i = read(fd, sp = b.s, sizeof(b.s));
+            sp = ingest_buffer(&ingest, &space);
+            i = read(fd, sp, space*sizeof(sp[0]));
             if (i < 0 && errno != EAGAIN) {
                 perror("read");
                 exit(4);
@@ -414,22 +512,9 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
             if (!i)
                 break;
             if (i > 0) {
-                if(integer_only)
-        {
-                    fbuf_cnt = i/sizeof(b.s[0]);
-        }
-                else
-                {
-                    for (; i >= sizeof(b.s[0]); i -= sizeof(b.s[0]), sp++)
-                        fbuf[fbuf_cnt++] = (*sp) * (1.0/32768.0);
-                    if (i)
-                        fprintf(stderr, "warning: noninteger number of samples read\n");
-                }
-                if (fbuf_cnt > overlap) {
-                    process_buffer(fbuf, b.s, fbuf_cnt-overlap);
-                    memmove(fbuf, fbuf+fbuf_cnt-overlap, overlap*sizeof(fbuf[0]));
-                    fbuf_cnt = overlap;
-                }
+                if (i % sizeof(sp[0]))
+                    fprintf(stderr, "warning: noninteger number of samples read\n");
+                ingest_commit(&ingest, i/sizeof(sp[0]));
             }
         }
     }
@@ -439,6 +524,123 @@ static void input_sound(unsigned int sample_rate, unsigned int overlap,
 
 /* ---------------------------------------------------------------------- */
 
+#define INDEX_PAD_MS 1000 /* decoded before and after every active range */
+#define INDEX_GAP_MS 250  /* silence between ranges, makes the demodulators let go */
+
+static void input_indexed(unsigned int sample_rate, unsigned int overlap,
+                          int fd, const char *idxname)
+{
+    static const short zero[1024];
+    struct actindex_header hdr;
+    struct actindex_block *blk;
+    struct stat statbuf;
+    uint64_t nblk, pos = 0, start, end, pad, decoded = 0;
+    short *sp;
+    unsigned int space, gap;
+    off_t left;
+    int ifd, i;
+
+    if ((ifd = open(idxname, O_RDONLY)) < 0) {
+        perror("open");
+        exit(10);
+    }
+    if (read(ifd, &hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != ACTINDEX_MAGIC ||
+        hdr.version != ACTINDEX_VERSION || hdr.record_size != sizeof(*blk) ||
+        hdr.header_size < sizeof(hdr) || !hdr.block_len || fstat(ifd, &statbuf) ||
+        statbuf.st_size < hdr.header_size) {
+        fprintf(stderr, "index: %s is not an activity index\n", idxname);
+        exit(10);
+    }
+    if (hdr.sample_rate != sample_rate) {
+        fprintf(stderr, "Error: index %s was built for %u Hz, "
+                "the demodulators require %u Hz\n", idxname, hdr.sample_rate, sample_rate);
+        exit(3);
+    }
+    nblk = (statbuf.st_size - hdr.header_size) / sizeof(*blk);
+    if (!(blk = malloc(nblk * sizeof(*blk) + 1))) {
+        perror("malloc");
+        exit(10);
+    }
+    if (lseek(ifd, hdr.header_size, SEEK_SET) < 0 ||
+        read(ifd, blk, nblk * sizeof(*blk)) != (int)(nblk * sizeof(*blk))) {
+        perror("index");
+        exit(10);
+    }
+    close(ifd);
+
+    pad = ((uint64_t)sample_rate * INDEX_PAD_MS / 1000 + hdr.block_len - 1) / hdr.block_len;
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
+    while (actindex_next_range(blk, nblk, &pos, pad, &start, &end)) {
+        verbprintf(1, "index: decoding %.1f s to %.1f s\n",
+                   (double)start * hdr.block_len / sample_rate,
+                   (double)end * hdr.block_len / sample_rate);
+        if (lseek(fd, (off_t)(start * hdr.block_len * sizeof(short)), SEEK_SET) < 0) {
+            perror("lseek");
+            exit(10);
+        }
+        for (left = (end - start) * hdr.block_len; left > 0; left -= i) {
+            sp = ingest_buffer(&ingest, &space);
+            if (space > left)
+                space = left;
+            i = read(fd, sp, space*sizeof(sp[0]));
+            if (i < 0 && errno != EAGAIN) {
+                perror("read");
+                exit(4);
+            }
+            if (!i)
+                break;
+            i = i < 0 ? 0 : i / sizeof(sp[0]);
+            ingest_commit(&ingest, i);
+        }
+        decoded += end - start;
+        for (gap = sample_rate * INDEX_GAP_MS / 1000; gap > 0; gap -= i) {
+            i = gap > 1024 ? 1024 : gap;
+            ingest_samples(&ingest, zero, i);
+        }
+    }
+    verbprintf(1, "index: decoded %llu of %llu blocks\n",
+               (unsigned long long)decoded, (unsigned long long)nblk);
+    free(blk);
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Raw input with several interleaved channels, decoded by the DTMF and
+ * selcall lanes.
+ * A partial frame at the end of the input is dropped.
+ */
+static void input_channels(int fd)
+{
+    short buf[CHANNELS_MAX * 1024];
+    size_t fill = 0, frame = channels * sizeof(buf[0]), frames;
+    ssize_t i;
+
+    for (;;) {
+        i = read(fd, (char *)buf + fill, sizeof(buf) - fill);
+        if (i < 0 && errno != EAGAIN) {
+            perror("read");
+            exit(4);
+        }
+        if (!i)
+            break;
+        if (i < 0)
+            continue;
+        fill += i;
+        frames = fill / frame;
+        if (channels_dtmf)
+            dtmf_lanes_demod(buf, frames);
+        if (channels_selcall)
+            selcall_lanes_demod(buf, frames);
+        fill -= frames * frame;
+        memmove(buf, (char *)buf + frames * frame, fill);
+    }
+    if (fill)
+        fprintf(stderr, "warning: partial frame at the end of the input\n");
+}
+
+/* ---------------------------------------------------------------------- */
+
 static void input_file(unsigned int sample_rate, unsigned int overlap,
                        const char *fname, const char *type)
 {
@@ -447,10 +649,13 @@ static void input_file(unsigned int sample_rate, unsigned int overlap,
     int pid = 0, soxstat;
     int fd;
     int i;
-    short buffer[8192];
-    float fbuf[16384];
-    unsigned int fbuf_cnt = 0;
     short *sp;
+    unsigned int space;
+
+    if (index_file && (!strcmp(fname, "-") || (type && strcmp(type, "raw")))) {
+        fprintf(stderr, "--index needs a raw file to seek in\n");
+        exit(2);
+    }
 
     /*
      * if the input type is not raw, sox is started to convert the
@@ -517,8 +722,20 @@ static void input_file(unsigned int sample_rate, unsigned int overlap,
     /*
      * demodulate
      */
+    if (channels > 1) {
+        input_channels(fd);
+        close(fd);
+        return;
+    }
+    if (index_file) {
+        input_indexed(sample_rate, overlap, fd, index_file);
+        close(fd);
+        return;
+    }
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
     for (;;) {
-        i = read(fd, sp = buffer, sizeof(buffer));
+        sp = ingest_buffer(&ingest, &space);
+        i = read(fd, sp, space*sizeof(sp[0]));
         if (i < 0 && errno != EAGAIN) {
             perror("read");
             exit(4);
@@ -526,22 +743,9 @@ static void input_file(unsigned int sample_rate, unsigned int overlap,
         if (!i)
             break;
         if (i > 0) {
-            if(integer_only)
-            {
-                fbuf_cnt = i/sizeof(buffer[0]);
-            }
-            else
-            {
-                for (; (unsigned int) i >= sizeof(buffer[0]); i -= sizeof(buffer[0]), sp++)
-                    fbuf[fbuf_cnt++] = (*sp) * (1.0f/32768.0f);
-                if (i)
-                    fprintf(stderr, "warning: noninteger number of samples read\n");
-            }
-            if (fbuf_cnt > overlap) {
-                process_buffer(fbuf, buffer, fbuf_cnt-overlap);
-                memmove(fbuf, fbuf+fbuf_cnt-overlap, overlap*sizeof(fbuf[0]));
-                fbuf_cnt = overlap;
-            }
+            if (i % sizeof(sp[0]))
+                fprintf(stderr, "warning: noninteger number of samples read\n");
+            ingest_commit(&ingest, i/sizeof(sp[0]));
         }
     }
     close(fd);
@@ -551,6 +755,427 @@ static void input_file(unsigned int sample_rate, unsigned int overlap,
 #endif
 }
 
+/* ---------------------------------------------------------------------- */
+#ifdef SHM_INPUT
+
+#define SHM_POLL_NS 2000000
+
+static void input_shm(unsigned int sample_rate, unsigned int overlap,
+                      const char *name)
+{
+    struct shmring_header *hdr;
+    struct stat statbuf;
+    struct timespec idle = { 0, SHM_POLL_NS };
+    const unsigned char *data;
+    uint64_t rd, wr, res, overruns, reported = 0;
+    unsigned int cap, n, off, space, i;
+    short *sp;
+    int fd;
+
+    if ((fd = shm_open(name, O_RDWR, 0)) < 0) {
+        perror("shm_open");
+        exit(10);
+    }
+    if (fstat(fd, &statbuf)) {
+        perror("fstat");
+        exit(10);
+    }
+    if ((size_t)statbuf.st_size < SHMRING_HEADER_SIZE) {
+        fprintf(stderr, "shm: %s is not a sample ring\n", name);
+        exit(10);
+    }
+    hdr = mmap(NULL, statbuf.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        perror("mmap");
+        exit(10);
+    }
+    close(fd);
+
+    cap = hdr->capacity;
+    if (shmring_load(&hdr->magic) != SHMRING_MAGIC || hdr->version != SHMRING_VERSION ||
+        (hdr->format != SHMRING_FMT_S16 && hdr->format != SHMRING_FMT_F32) ||
+        !cap || (cap & (cap - 1)) ||
+        hdr->header_size + (uint64_t)cap * shmring_sample_size(hdr->format) >
+        (uint64_t)statbuf.st_size) {
+        fprintf(stderr, "shm: %s is not a valid sample ring\n", name);
+        exit(10);
+    }
+    if (hdr->sample_rate != sample_rate) {
+        fprintf(stderr, "Error: shm ring %s runs at %u Hz, "
+                "demodulators require %u\n", name, hdr->sample_rate, sample_rate);
+        exit(3);
+    }
+    data = (const unsigned char *)hdr + hdr->header_size;
+
+    /* join at the live edge, everything older is history */
+    __atomic_add_fetch(&hdr->consumers, 1, __ATOMIC_ACQ_REL);
+    rd = shmring_load(&hdr->write_index);
+    shmring_store(&hdr->read_index, rd);
+    reported = shmring_load(&hdr->overruns);
+
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
+    for (;;) {
+        /* in this order, so that res - cap <= wr */
+        res = shmring_load(&hdr->write_reserve);
+        wr = shmring_load(&hdr->write_index);
+        if (res - rd > cap)
+            rd = res - cap; /* lapped, the producer accounts for the loss */
+        if (wr == rd) {
+            if (shmring_load(&hdr->flags) & SHMRING_FLAG_EOF)
+                break;
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        off = rd & (cap - 1);
+        n = wr - rd;
+        if (n > cap - off)
+            n = cap - off;
+        sp = ingest_buffer(&ingest, &space);
+        if (n > space)
+            n = space;
+        if (hdr->format == SHMRING_FMT_S16) {
+            memcpy(sp, data + off * sizeof(short), n * sizeof(short));
+        } else {
+            const float *fp = (const float *)data + off;
+            for (i = 0; i < n; i++) {
+                float f = fp[i] * 32768.0f;
+                sp[i] = f >= 32767.0f ? 32767 : f <= -32768.0f ? -32768 : (short)f;
+            }
+        }
+        /* the producer may have started overwriting the block while we copied it */
+        shmring_fence(__ATOMIC_ACQUIRE);
+        if (shmring_load(&hdr->write_reserve) - rd > cap)
+            continue;
+        ingest_commit(&ingest, n);
+        rd += n;
+        shmring_store(&hdr->read_index, rd);
+
+        overruns = shmring_load(&hdr->overruns);
+        if (overruns != reported) {
+            fprintf(stderr, "shm: producer overrun, %llu samples lost\n",
+                    (unsigned long long)(overruns - reported));
+            reported = overruns;
+        }
+    }
+    __atomic_sub_fetch(&hdr->consumers, 1, __ATOMIC_ACQ_REL);
+    munmap(hdr, statbuf.st_size);
+}
+
+#endif /* SHM_INPUT */
+
+/* ---------------------------------------------------------------------- */
+#ifdef NET_INPUT
+
+#define NET_BATCH      16   /* datagrams fetched per recvmmsg() */
+#define NET_SLOTS      64   /* jitter buffer capacity in datagrams */
+#define NET_TIMEOUT_MS 200  /* give up on missing datagrams after this much silence */
+#define NET_RESTART    4096 /* a sequence jump this large is a restarted sender */
+
+static unsigned int net_jitter_depth = 4;
+
+static struct net_jitter {
+    struct net_slot {
+        bool used, played;
+        uint32_t seq;
+        unsigned int len;
+        short samples[NETPCM_MAXSAMPLES];
+    } slot[NET_SLOTS];
+    bool started;
+    uint32_t next_seq;
+    unsigned int held;
+    unsigned int last_len;
+    unsigned int sample_rate;
+    uint64_t received, lost, late, duplicate, malformed;
+} jb;
+
+static int net_socket(const char *addr, int socktype, bool *passive)
+{
+    struct addrinfo hints, *res, *ai;
+    char host[256];
+    const char *port = addr;
+    const char *colon = strrchr(addr, ':');
+    int fd = -1, err, one = 1;
+
+    host[0] = 0;
+    if (colon) {
+        if ((size_t)(colon - addr) >= sizeof(host)) {
+            fprintf(stderr, "net: address too long: %s\n", addr);
+            exit(10);
+        }
+        memcpy(host, addr, colon - addr);
+        host[colon - addr] = 0;
+        port = colon + 1;
+    }
+    /* UDP always receives; TCP connects if a host is given and listens otherwise */
+    *passive = socktype == SOCK_DGRAM || !host[0];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = socktype;
+    hints.ai_flags = *passive ? AI_PASSIVE : 0;
+    if ((err = getaddrinfo(host[0] ? host : NULL, port, &hints, &res))) {
+        fprintf(stderr, "net: %s: %s\n", addr, gai_strerror(err));
+        exit(10);
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue;
+        if (*passive) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (!bind(fd, ai->ai_addr, ai->ai_addrlen))
+                break;
+        } else if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        perror(*passive ? "bind" : "connect");
+        exit(10);
+    }
+    return fd;
+}
+
+/*
+ * Missing samples are replaced by silence so the sample clock stays
+ * continuous. The demodulators see a carrier drop out, which makes them
+ * discard partial frames and resynchronise just as after a fade. More than
+ * a second of silence would not change that, so gaps are capped there.
+ */
+static void net_conceal(uint64_t samples)
+{
+    static const short zero[1024];
+
+    if (samples > jb.sample_rate)
+        samples = jb.sample_rate;
+    while (samples > 0) {
+        unsigned int n = samples > 1024 ? 1024 : samples;
+        ingest_samples(&ingest, zero, n);
+        samples -= n;
+    }
+}
+
+/* Play out in-order datagrams; 'flush' also skips holes until the buffer is empty. */
+static void net_play(bool flush)
+{
+    struct net_slot *sl;
+    uint32_t first = jb.next_seq;
+
+    while (jb.held) {
+        sl = &jb.slot[jb.next_seq % NET_SLOTS];
+        if (sl->used && sl->seq == jb.next_seq) {
+            if (jb.next_seq != first)
+                verbprintf(2, "udp: datagrams %u-%u lost\n", first, jb.next_seq - 1);
+            ingest_samples(&ingest, sl->samples, sl->len);
+            jb.last_len = sl->len;
+            sl->used = false;
+            sl->played = true;
+            jb.held--;
+            first = ++jb.next_seq;
+            continue;
+        }
+        if (!flush && jb.held <= net_jitter_depth)
+            break;
+        jb.lost++;
+        net_conceal(jb.last_len);
+        jb.next_seq++;
+    }
+}
+
+static void net_datagram(const unsigned char *buf, size_t len)
+{
+    struct netpcm_header hdr;
+    struct net_slot *sl;
+    int32_t ahead;
+
+    if (len < sizeof(hdr) || (len - sizeof(hdr)) % sizeof(short)) {
+        jb.malformed++;
+        return;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (ntohl(hdr.magic) != NETPCM_MAGIC) {
+        jb.malformed++;
+        return;
+    }
+    hdr.seq = ntohl(hdr.seq);
+    jb.received++;
+    if (!jb.started) {
+        jb.started = true;
+        jb.next_seq = hdr.seq;
+    }
+
+    ahead = (int32_t)(hdr.seq - jb.next_seq);
+    if (ahead >= NET_RESTART || ahead <= -NET_RESTART) {
+        verbprintf(1, "udp: sender restarted (sequence %u, expected %u)\n", hdr.seq, jb.next_seq);
+        net_play(true);
+        net_conceal(jb.sample_rate);
+        jb.next_seq = hdr.seq;
+        ahead = 0;
+    } else if (ahead < 0) {
+        /* the slot still remembers a datagram that was played out */
+        sl = &jb.slot[hdr.seq % NET_SLOTS];
+        if (ahead >= -NET_SLOTS && sl->played && sl->seq == hdr.seq)
+            jb.duplicate++;
+        else
+            jb.late++;
+        return;
+    }
+    /* make room: everything that no longer fits behind this datagram is gone */
+    while (ahead >= NET_SLOTS) {
+        sl = &jb.slot[jb.next_seq % NET_SLOTS];
+        if (sl->used && sl->seq == jb.next_seq) {
+            ingest_samples(&ingest, sl->samples, sl->len);
+            jb.last_len = sl->len;
+            sl->used = false;
+            sl->played = true;
+            jb.held--;
+        } else {
+            jb.lost++;
+            net_conceal(jb.last_len);
+        }
+        jb.next_seq++;
+        ahead--;
+    }
+
+    sl = &jb.slot[hdr.seq % NET_SLOTS];
+    if (sl->used) {
+        jb.duplicate++;
+        return;
+    }
+    sl->used = true;
+    sl->played = false;
+    sl->seq = hdr.seq;
+    sl->len = (len - sizeof(hdr)) / sizeof(short);
+    memcpy(sl->samples, buf + sizeof(hdr), sl->len * sizeof(short));
+    jb.held++;
+    net_play(false);
+}
+
+static void input_udp(unsigned int sample_rate, unsigned int overlap,
+                      const char *addr)
+{
+    static unsigned char pkt[NET_BATCH][sizeof(struct netpcm_header) + NETPCM_MAXSAMPLES*sizeof(short)];
+    struct timeval tv = { 0, NET_TIMEOUT_MS * 1000 };
+    int fd, n, i, rcvbuf = 1 << 20;
+    bool passive;
+#ifdef __linux__
+    struct mmsghdr msgs[NET_BATCH];
+    struct iovec iov[NET_BATCH];
+
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < NET_BATCH; i++) {
+        iov[i].iov_base = pkt[i];
+        iov[i].iov_len = sizeof(pkt[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+
+    fd = net_socket(addr, SOCK_DGRAM, &passive);
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&jb, 0, sizeof(jb));
+    jb.sample_rate = sample_rate;
+    if (net_jitter_depth >= NET_SLOTS)
+        net_jitter_depth = NET_SLOTS - 1;
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
+
+    for (;;) {
+#ifdef __linux__
+        n = recvmmsg(fd, msgs, NET_BATCH, MSG_WAITFORONE, NULL);
+#else
+        n = recv(fd, pkt[0], sizeof(pkt[0]), 0);
+        if (n >= 0) {
+            i = n;
+            n = 1;
+        }
+#endif
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                net_play(true); /* nothing arriving, stop waiting for stragglers */
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            perror("recv");
+            exit(4);
+        }
+        for (int k = 0; k < n; k++) {
+#ifdef __linux__
+            size_t len = msgs[k].msg_len;
+            if (msgs[k].msg_hdr.msg_flags & MSG_TRUNC) {
+                jb.malformed++;
+                continue;
+            }
+#else
+            size_t len = i;
+#endif
+            if (len == sizeof(struct netpcm_header)) { /* end of stream */
+                net_play(true);
+                goto done;
+            }
+            net_datagram(pkt[k], len);
+        }
+    }
+done:
+    close(fd);
+    fprintf(stderr, "udp: %llu datagrams received, %llu lost, %llu late, "
+            "%llu duplicate, %llu malformed\n",
+            (unsigned long long)jb.received, (unsigned long long)jb.lost,
+            (unsigned long long)jb.late, (unsigned long long)jb.duplicate,
+            (unsigned long long)jb.malformed);
+}
+
+static void input_tcp(unsigned int sample_rate, unsigned int overlap,
+                      const char *addr)
+{
+    unsigned char *bp, odd;
+    unsigned int space, carry = 0;
+    bool passive;
+    int fd, conn, i;
+
+    fd = net_socket(addr, SOCK_STREAM, &passive);
+    if (passive) {
+        if (listen(fd, 1)) {
+            perror("listen");
+            exit(10);
+        }
+        if ((conn = accept(fd, NULL, NULL)) < 0) {
+            perror("accept");
+            exit(10);
+        }
+        close(fd);
+        fd = conn;
+    }
+
+    ingest_init(&ingest, sample_rate, overlap, !integer_only);
+    for (;;) {
+        /* a stream may split samples across reads, keep the odd byte */
+        bp = (unsigned char *)ingest_buffer(&ingest, &space);
+        i = read(fd, bp + carry, space*sizeof(short) - carry);
+        if (i < 0 && errno != EAGAIN && errno != EINTR) {
+            perror("read");
+            exit(4);
+        }
+        if (!i)
+            break;
+        if (i < 0)
+            continue;
+        i += carry;
+        carry = i % sizeof(short);
+        if (carry)
+            odd = bp[i - carry];
+        ingest_commit(&ingest, i / sizeof(short));
+        if (carry)
+            *(unsigned char *)ingest_buffer(&ingest, &space) = odd;
+    }
+    close(fd);
+}
+
+#endif /* NET_INPUT */
+
 void quit(void)
 {
     int i = 0;
@@ -560,6 +1185,11 @@ void quit(void)
             if (dem[i]->deinit)
                 dem[i]->deinit(dem_st+i);
     }
+    selcall_lanes_deinit();
+    bitdump_close();
+#ifdef KISS_OUTPUT
+    kiss_close();
+#endif
 }
 
 /* ---------------------------------------------------------------------- */
@@ -569,6 +1199,10 @@ static const char usage_str[] = "\n"
         "  If no [file] is given, input will be read from your default sound\n"
         "  hardware. A filename of \"-\" denotes standard input.\n"
         "  -t <type>  : Input file type (any other type than raw requires sox)\n"
+        "               'shm' reads from the named POSIX shared memory ring\n"
+        "               'udp' receives datagrams on [host:]port, 'tcp' connects to\n"
+        "               host:port or accepts one connection on port\n"
+        "               'bits' replays a bit stream dump made with --bitdump\n"
         "  -a <demod> : Add demodulator\n"
         "  -s <demod> : Subtract demodulator\n"
         "  -c         : Remove all demodulators (must be added with -a <demod>)\n"
@@ -597,6 +1231,26 @@ static const char usage_str[] = "\n"
         "  -y         : CW: Disable auto timing detection\n"
         "  --timestamp: Add a time stamp in front of every printed line\n"
         "  --label    : Add a label to the front of every printed line\n"
+        "  --gain <g> : Scale input samples by <g> (float demodulators only)\n"
+        "  --dc-block : Remove DC offset from input (float demodulators only)\n"
+        "  --jitter <n>: UDP: Datagrams held back for reordering (default: 4)\n"
+        "  --index <f>: Only decode the active parts of a raw file, as listed in\n"
+        "               the activity index <f> built by actindex-ng\n"
+        "  --bitdump <f>: Record the bits the demodulators pass to their\n"
+        "               protocol decoders to <f>, for replay with -t bits\n"
+        "  --flex-threads <n>: FLEX: Error correct on <n> worker threads and\n"
+        "               decode frames off the demodulator thread\n"
+        "  --channels <n>: DTMF, selcall: Raw input carries <n> interleaved channels\n"
+        "               (up to 16), decoded side by side\n"
+        "  --ax25-fix <n>: AX.25: Try up to <n> single and adjacent double bit\n"
+        "               flips on frames failing their CRC (default: 0, off)\n"
+        "  --afsk-slicers <k>: AFSK1200: Run <k> (up to 8) slicers with different\n"
+        "               tone weights on one demodulator, print each frame once\n"
+#ifdef KISS_OUTPUT
+        "  --kiss <pty|[host:]port>: AX.25: Send frames to KISS clients on a\n"
+        "               pseudo terminal or a TCP port (localhost unless host is\n"
+        "               given) instead of printing them\n"
+#endif
         "   Raw input requires one channel, 16 bit, signed integer (platform-native)\n"
         "   samples at the demodulator's input sampling rate, which is\n"
         "   usually 22050 Hz. Raw input is assumed and required if piped input is used.\n";
@@ -618,6 +1272,16 @@ int main(int argc, char *argv[])
         {"timestamp", no_argument, &timestamp, 1},
         {"label", required_argument, NULL, 'l'},
         {"charset", required_argument, NULL, 'C'},
+        {"gain", required_argument, NULL, 'G'},
+        {"dc-block", no_argument, NULL, 'D'},
+        {"jitter", required_argument, NULL, 'J'},
+        {"index", required_argument, NULL, 'I'},
+        {"bitdump", required_argument, NULL, 'B'},
+        {"flex-threads", required_argument, NULL, 'F'},
+        {"channels", required_argument, NULL, 'N'},
+        {"ax25-fix", required_argument, NULL, 'X'},
+        {"afsk-slicers", required_argument, NULL, 'K'},
+        {"kiss", required_argument, NULL, 'S'},
         {0, 0, 0, 0}
       };
 
@@ -712,7 +1376,7 @@ intypefound:
 
         case 's':
             if (mask_first)
-                memset(dem_mask, 0xff, sizeof(dem_mask));
+                mask_all();
             mask_first = 0;
             for (i = 0; (unsigned int) i < NUMDEMOD; i++)
                 if (!strcasecmp(optarg, dem[i]->name)) {
@@ -795,6 +1459,64 @@ intypefound:
 	case 'l':
 	    label = optarg;
 	    break;
+
+        case 'G':
+            ingest_gain = strtof(optarg, NULL);
+            break;
+
+        case 'D':
+            ingest_dc_block = true;
+            break;
+
+        case 'I':
+            index_file = optarg;
+            break;
+
+        case 'B':
+            bitdump_file = optarg;
+            break;
+
+        case 'F':
+#ifdef FLEX_THREADS
+            flex_threads = strtoul(optarg, NULL, 0);
+#else
+            fprintf(stderr, "--flex-threads: built without thread support\n");
+#endif
+            break;
+
+        case 'N':
+            channels = strtoul(optarg, NULL, 0);
+            if (channels < 1 || channels > CHANNELS_MAX) {
+                fprintf(stderr, "--channels: 1 to %d channels\n", CHANNELS_MAX);
+                exit(2);
+            }
+            break;
+
+        case 'X':
+            hdlc_fix_max = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'K':
+            afsk12_slicers = strtoul(optarg, NULL, 0);
+            if (afsk12_slicers < 1 || afsk12_slicers > 8) {
+                fprintf(stderr, "--afsk-slicers: 1 to 8 slicers\n");
+                exit(2);
+            }
+            break;
+
+        case 'S':
+#ifdef KISS_OUTPUT
+            kiss_spec = optarg;
+#else
+            fprintf(stderr, "--kiss: built without KISS support\n");
+#endif
+            break;
+
+        case 'J':
+#ifdef NET_INPUT
+            net_jitter_depth = strtoul(optarg, NULL, 0);
+#endif
+            break;
         }
     }
 
@@ -816,7 +1538,12 @@ intypefound:
         exit(2);
     }
     if (mask_first)
-        memset(dem_mask, 0xff, sizeof(dem_mask));
+        mask_all();
+#ifdef KISS_OUTPUT
+    /* before the demodulators, which take their KISS ports in init */
+    if (kiss_spec)
+        kiss_open(kiss_spec);
+#endif
 
     if (!quietflg)
         fprintf(stdout, "Enabled demodulators:");
@@ -845,11 +1572,52 @@ intypefound:
     if (!quietflg)
         fprintf(stdout, "\n");
 
-    if (optind < argc && !strcmp(argv[optind], "-"))
+    if (optind < argc && !strcmp(argv[optind], "-") && strcmp(input_type, "bits"))
     {
         input_type = "raw";
     }
 
+    if (channels > 1) {
+        const struct demod_param *std[sizeof(selcall_demods) / sizeof(selcall_demods[0])];
+        unsigned int nstd = 0, k;
+
+        for (i = 0; (unsigned int) i < NUMDEMOD; i++) {
+            if (!MASK_ISSET(i))
+                continue;
+            if (dem[i] == &demod_dtmf) {
+                channels_dtmf = true;
+                continue;
+            }
+            for (k = 0; k < sizeof(selcall_demods) / sizeof(selcall_demods[0]); k++)
+                if (dem[i] == selcall_demods[k])
+                    break;
+            if (k == sizeof(selcall_demods) / sizeof(selcall_demods[0])) {
+                fprintf(stderr, "--channels: only DTMF and selcall decode several channels, not %s\n",
+                        dem[i]->name);
+                exit(2);
+            }
+            std[nstd++] = dem[i];
+        }
+        if (strcmp(input_type, "raw") || index_file || bitdump_file) {
+            fprintf(stderr, "--channels needs raw input, without --index or --bitdump\n");
+            exit(2);
+        }
+        if (channels_dtmf)
+            dtmf_lanes_init(channels);
+        if (nstd) {
+            channels_selcall = true;
+            selcall_lanes_init(channels, std, nstd);
+        }
+    }
+
+    if (bitdump_file) {
+        if (!strcmp(input_type, "bits")) {
+            fprintf(stderr, "--bitdump and -t bits can't be combined\n");
+            exit(2);
+        }
+        bitdump_open(bitdump_file, sample_rate);
+    }
+
     if (!strcmp(input_type, "hw")) {
         if ((argc - optind) >= 1)
             input_sound(sample_rate, overlap, argv[optind]);
@@ -864,6 +1632,21 @@ intypefound:
     }
 
     for (i = optind; i < argc; i++)
+#ifdef SHM_INPUT
+        if (!strcmp(input_type, "shm"))
+            input_shm(sample_rate, overlap, argv[i]);
+        else
+#endif
+#ifdef NET_INPUT
+        if (!strcmp(input_type, "udp"))
+            input_udp(sample_rate, overlap, argv[i]);
+        else if (!strcmp(input_type, "tcp"))
+            input_tcp(sample_rate, overlap, argv[i]);
+        else
+#endif
+        if (!strcmp(input_type, "bits"))
+            bitdump_replay(argv[i], find_demod);
+        else
         input_file(sample_rate, overlap, argv[i], input_type);
 
     quit();
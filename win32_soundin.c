@@ -1,5 +1,6 @@
 #include <Windows.h>
 #include <stdio.h>
+#include "multimon.h"
 
 #define BUFFER_LEN_IN_MS 20 
 #define BUFFERS 50
@@ -8,9 +9,7 @@ int SAMPLES_PER_BUFFER;
 WAVEFORMATEX g_WavFmt = {0};
 HWAVEIN hWavIn;
 
-void process_buffer(float *float_buf, short *short_buf, unsigned int len);
-int Overlap;
-float *fbuf;
+static struct sample_ingest ingest;
 
 void CALLBACK waveInProc(HWAVEIN hwi,UINT uMsg,DWORD dwInstance,DWORD dwParam1,DWORD dwParam2)
 {
@@ -21,14 +20,8 @@ void CALLBACK waveInProc(HWAVEIN hwi,UINT uMsg,DWORD dwInstance,DWORD dwParam1,D
 	case MM_WIM_DATA:
 		pWaveHdr = ((WAVEHDR*)dwParam1 );
 		sp = (SHORT*)pWaveHdr->lpData;
-                int i;
-                for (i=0; i<SAMPLES_PER_BUFFER; i++)
-		{
-			fbuf[i+Overlap] = sp[i] /32768.0;
-		}
+		ingest_samples(&ingest, sp, SAMPLES_PER_BUFFER);
 		waveInAddBuffer(hwi, pWaveHdr, sizeof(WAVEHDR));
-		process_buffer(fbuf, sp, SAMPLES_PER_BUFFER);
-		memcpy(&fbuf[0],&fbuf[SAMPLES_PER_BUFFER],sizeof(float)*Overlap);
 		break;
 	case MM_WIM_OPEN:
 		break;
@@ -39,9 +32,8 @@ void CALLBACK waveInProc(HWAVEIN hwi,UINT uMsg,DWORD dwInstance,DWORD dwParam1,D
 
 void input_sound(unsigned int sample_rate, unsigned int overlap, const char *ifname)
 {
-	Overlap = overlap;
 	SAMPLES_PER_BUFFER = (BUFFER_LEN_IN_MS / 1000.0)*sample_rate;
-	fbuf = (float*)malloc(sizeof(float)*(SAMPLES_PER_BUFFER+Overlap));
+	ingest_init(&ingest, sample_rate, overlap, true);
 	hWavIn=0;
 	g_WavFmt.wFormatTag = WAVE_FORMAT_PCM;
     g_WavFmt.nChannels = 1;